@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "esp32_can_library.h"
+#ifndef ARDUINO
+#include "host_twai.h"
+#endif
+
+// Micro-Benchmarks der Library (pio run -e benchmark -t upload -t monitor,
+// auf dem Host: pio run -e bench_native -t exec)
+// Ausgabe: eine JSON-Zeile je Messung, z. B.
+//   {"bench":"send","param":8,"iters":40000,"ns_per_op":2150.0,"allocs_per_op":0.00}
+// Gesendet wird im Produktionspfad (ohne Fault-Injection) gegen einen Treiber-Stub:
+// auf dem ESP32 ersetzt -Wl,--wrap=twai_transmit den Treiberaufruf, auf dem Host der
+// Shim in tools/host. Gemessen wird die Library bis zum Treiber, nicht die Busrate.
+// Empfang läuft über injectFrame (ohne twai_receive).
+
+#ifdef ARDUINO
+// twai_transmit ohne Bus: kehrt sofort zurück, die TX-Queue läuft nie voll
+extern "C" esp_err_t __wrap_twai_transmit(const twai_message_t*, TickType_t) { return ESP_OK; }
+#endif
+
+// -----------------------------
+// Allokationen zählen
+// -----------------------------
+static std::atomic<uint32_t> g_allocs{0};
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(n ? n : 1);
+    if (!p) abort();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// -----------------------------
+// Nachrichten für die Messungen
+// -----------------------------
+// Alle sieben Type-IDs (0..6) belegt; 0..3 passen in einen Frame (Dispatch-Messung)
+template<size_t N> struct Blob { uint8_t d[N]; };
+DEFINE_CAN_MESSAGE(Msg1,  0, Blob<1> b;);
+DEFINE_CAN_MESSAGE(Msg8,  1, Blob<8> b;);
+DEFINE_CAN_MESSAGE(Msg5,  2, Blob<5> b;);
+DEFINE_CAN_MESSAGE(Msg6,  3, Blob<6> b;);
+DEFINE_CAN_MESSAGE(Msg16, 4, Blob<16> b;);
+DEFINE_CAN_MESSAGE(Msg32, 5, Blob<32> b;);
+DEFINE_CAN_MESSAGE(Msg61, 6, Blob<61> b;);
+
+CANBus can(GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_NO_ACK);
+volatile uint32_t g_sink = 0;      // verhindert, dass Callbacks wegoptimiert werden
+uint32_t g_hits[CANBus::ACK_TYPE_ID] = {};     // Zustellungen je Type-ID
+
+template<typename T>
+void countHandler() {
+    can.onReceive<T>([](const T& m) {
+        g_sink += m.b.d[0];
+        ++g_hits[CANBus::MsgType<T>::TypeID];
+    });
+}
+
+// Messung ungültig, wenn der Handler nie aufgerufen wurde (falsche Type-ID/Größe)
+void expectDelivered(const char* name, uint8_t type, uint32_t hitsBefore) {
+    if (g_hits[type] == hitsBefore)
+        Serial.printf("{\"bench\":\"%s\",\"error\":\"handler for type %u not called\"}\n",
+                      name, unsigned(type));
+}
+
+// -----------------------------
+// Messrahmen
+// -----------------------------
+// Verdoppelt die Iterationen, bis ein Lauf mindestens 100 ms dauert
+template<typename F>
+void measure(const char* name, uint32_t param, F f) {
+    f();    // Aufwärmen (Map-Einträge, Caches)
+    uint32_t iters = 16;
+    while (true) {
+        uint32_t allocs = g_allocs.load();
+        int64_t start = esp_timer_get_time();
+        for (uint32_t i = 0; i < iters; ++i) f();
+        int64_t us = esp_timer_get_time() - start;
+        allocs = g_allocs.load() - allocs;
+        if (us >= 100000 || iters >= (1u << 24)) {
+            Serial.printf("{\"bench\":\"%s\",\"param\":%u,\"iters\":%u,\"ns_per_op\":%.1f,"
+                          "\"allocs_per_op\":%.2f}\n",
+                          name, unsigned(param), unsigned(iters), us * 1000.0 / iters,
+                          double(allocs) / iters);
+            return;
+        }
+        iters *= 2;
+    }
+}
+
+// Frames einer Nachricht so aufbauen, wie send() sie fragmentiert (Nutzdaten + CRC8)
+struct Frame { uint32_t id; uint8_t dlc; uint8_t data[8]; };
+
+std::vector<Frame> buildFrames(uint8_t type, size_t len) {
+    std::vector<uint8_t> payload(len);
+    for (size_t i = 0; i < len; ++i) payload[i] = static_cast<uint8_t>(i * 7);
+    std::vector<Frame> frames;
+    if (len <= 8) {
+        Frame f{(3u << 5) | (3u << 3) | type, static_cast<uint8_t>(len), {}};
+        memcpy(f.data, payload.data(), len);
+        frames.push_back(f);
+        return frames;
+    }
+    payload.push_back(CANReassembler::crc8(payload.data(), len));
+    for (size_t off = 0; off < payload.size(); off += 8) {
+        uint8_t seq = off == 0 ? 0 : (off + 8 >= payload.size() ? 2 : 1);
+        Frame f{(3u << 5) | (static_cast<uint32_t>(seq) << 3) | type,
+                static_cast<uint8_t>(std::min<size_t>(8, payload.size() - off)), {}};
+        memcpy(f.data, payload.data() + off, f.dlc);
+        frames.push_back(f);
+    }
+    return frames;
+}
+
+template<typename T>
+void benchSend() {
+    T msg{};
+    measure("send", sizeof(T), [&]() { can.send<T>(1, 2, msg); });
+}
+
+template<typename T>
+void benchReceive(const char* name) {
+    constexpr uint8_t type = CANBus::MsgType<T>::TypeID;
+    std::vector<Frame> frames = buildFrames(type, sizeof(T));
+    int64_t t = 0;
+    uint32_t hits = g_hits[type];
+    measure(name, sizeof(T), [&]() {
+        for (const Frame& f : frames) can.injectFrame(f.id, f.data, f.dlc, t);
+        t += 100;
+    });
+    expectDelivered(name, type, hits);
+}
+
+// Reihum Einzelframes der Typen 0..min(handlers, 4)-1; weitere Handler vergrößern nur die Tabelle
+const uint8_t SINGLE_FRAME_TYPES = 4;
+const size_t SINGLE_FRAME_SIZE[SINGLE_FRAME_TYPES] = {sizeof(Msg1), sizeof(Msg8), sizeof(Msg5), sizeof(Msg6)};
+
+void benchDispatch(uint8_t handlers) {
+    std::vector<Frame> frames;
+    uint32_t hits[SINGLE_FRAME_TYPES];
+    for (uint8_t type = 0; type < handlers && type < SINGLE_FRAME_TYPES; ++type) {
+        frames.push_back(buildFrames(type, SINGLE_FRAME_SIZE[type])[0]);
+        hits[type] = g_hits[type];
+    }
+    size_t i = 0;
+    measure("dispatch", handlers, [&]() {
+        const Frame& f = frames[i++ % frames.size()];
+        can.injectFrame(f.id, f.data, f.dlc, 0);
+    });
+    for (uint8_t type = 0; type < frames.size(); ++type) expectDelivered("dispatch", type, hits[type]);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(500);
+    can.init();
+    can.setRetryLimit(0);
+#ifndef ARDUINO
+    hostTwaiSetTxLog(false);
+#endif
+
+    // send<T>: Einzelframe und fragmentiert
+    benchSend<Msg1>();
+    benchSend<Msg8>();
+    benchSend<Msg16>();
+    benchSend<Msg32>();
+    benchSend<Msg61>();
+
+    // Zustellung mit 1–7 registrierten Handlern (Type-IDs 0..6)
+    for (uint8_t n = 1; n <= CANBus::ACK_TYPE_ID; ++n) {
+        switch (n) {
+        case 1: countHandler<Msg1>(); break;
+        case 2: countHandler<Msg8>(); break;
+        case 3: countHandler<Msg5>(); break;
+        case 4: countHandler<Msg6>(); break;
+        case 5: countHandler<Msg16>(); break;
+        case 6: countHandler<Msg32>(); break;
+        default: countHandler<Msg61>(); break;
+        }
+        benchDispatch(n);
+    }
+
+    // Empfangspfad: SINGLE und fragmentierte Streams
+    benchReceive<Msg8>("receive_single");
+    benchReceive<Msg16>("receive_fragmented");
+    benchReceive<Msg32>("receive_fragmented");
+    benchReceive<Msg61>("receive_fragmented");
+
+    // crc8 über 8–4096 Byte
+    static uint8_t buf[4096];
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = static_cast<uint8_t>(i);
+    for (size_t len = 8; len <= sizeof(buf); len *= 2)
+        measure("crc8", len, [&]() { g_sink += CANReassembler::crc8(buf, len); });
+
+    Serial.println("{\"bench\":\"done\"}");
+}
+
+void loop() {
+    delay(1000);
+}
+
+#ifndef ARDUINO
+int main() {
+    setup();
+    return 0;
+}
+#endif
@@ -0,0 +1,91 @@
+/**
+Binärformat für Bus-Mitschnitte (Capture)
+=========================================
+Unabhängig vom TWAI-Treiber, damit auch Auswerte-Tools am PC es einbinden können.
+Alle Felder Little Endian (ESP32 und x86 identisch).
+
+Datei/Partition = Folge von Blöcken zu BLOCK_SIZE Byte (= ein Flash-Sektor):
+  BlockHeader | Record[count] | ungenutzter Rest
+Record-Zeitstempel sind relativ zu BlockHeader::baseUs.
+
+Index je Block: Zeitbereich [baseUs, lastUs] und eine Bitmap aller vorkommenden
+Identifier. Blöcke sind nach seq zeitlich geordnet; ein Leser kann so per Binärsuche
+nach Zeit springen und Blöcke ohne gesuchte Identifier überspringen, ohne Records zu
+lesen.
+
+Sitzungsindex: Zwischen den Datenblöcken schreibt der Writer Indexblöcke
+  IndexHeader | IndexEntry[count]
+mit den Zeitbereichen der count Datenblöcke direkt davor. Der letzte Indexblock einer
+Sitzung (Trailer, flags & INDEX_TRAILER) trägt die Anzahl aller Blöcke der Sitzung.
+Ein Leser beginnt am letzten beschriebenen Block und läuft über die Indexblöcke
+rückwärts, ohne die Datenblöcke anzufassen; davor liegt der Trailer der vorigen
+Sitzung (angehängte Mitschnitte beginnen wieder bei seq 0). Fehlt der Trailer
+(Abbruch, Stromausfall), bleibt die Suche über alle Blockheader. */
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include <cstdint>
+#include <cstddef>
+
+struct CANCapture {
+    static constexpr uint32_t BLOCK_MAGIC = 0x50414343;   // "CCAP"
+    static constexpr uint16_t VERSION     = 2;
+    static constexpr size_t   BLOCK_SIZE  = 4096;
+
+    struct BlockHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;         // belegte Records
+        uint32_t seq;           // fortlaufende Blocknummer
+        uint32_t reserved;
+        int64_t  baseUs;        // Zeitstempel des ersten Records (µs)
+        int64_t  lastUs;        // Zeitstempel des letzten Records (µs)
+        uint8_t  idIndex[256];  // Bit i gesetzt: Identifier i kommt im Block vor
+    };
+
+    struct Record {
+        uint32_t deltaUs;       // Abstand zu baseUs
+        uint16_t identifier;    // 11-Bit-Identifier
+        uint8_t  dlc;
+        uint8_t  flags;         // reserviert
+        uint8_t  data[8];
+    };
+
+    static constexpr size_t RECORDS_PER_BLOCK = (BLOCK_SIZE - sizeof(BlockHeader)) / sizeof(Record);
+
+    static constexpr uint32_t INDEX_MAGIC   = 0x58444943;   // "CIDX"
+    static constexpr uint16_t INDEX_TRAILER = 0x0001;
+
+    struct IndexHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;         // Einträge = Datenblöcke direkt vor diesem Block
+        uint16_t flags;
+        uint16_t reserved;
+        uint32_t sessionBlocks; // nur Trailer: Blöcke der Sitzung inkl. Index und Trailer
+    };
+
+    struct IndexEntry {
+        uint32_t seq;
+        uint16_t count;
+        uint16_t reserved;
+        int64_t  baseUs;
+        int64_t  lastUs;
+    };
+
+    static constexpr size_t INDEX_ENTRIES = (BLOCK_SIZE - sizeof(IndexHeader)) / sizeof(IndexEntry);
+
+    static bool hasId(const BlockHeader& h, uint16_t id) {
+        return (h.idIndex[(id & 0x7FF) >> 3] >> (id & 0x07)) & 1;
+    }
+
+    static void markId(BlockHeader& h, uint16_t id) {
+        h.idIndex[(id & 0x7FF) >> 3] |= static_cast<uint8_t>(1u << (id & 0x07));
+    }
+
+    static_assert(sizeof(BlockHeader) == 288, "BlockHeader-Layout");
+    static_assert(sizeof(Record) == 16, "Record-Layout");
+    static_assert(sizeof(IndexHeader) == 16 && sizeof(IndexEntry) == 24, "Index-Layout");
+};
+
+#endif // CAN_CAPTURE_H
@@ -0,0 +1,153 @@
+/**
+Fragment-Reassemblierung (START/MIDDLE/END + CRC8)
+==================================================
+Zustandsmaschine aus CANBus::handleReceive, unabhängig vom TWAI-Treiber, damit
+Auswerte-Tools am PC Mitschnitte exakt wie ein Empfänger zusammensetzen.
+
+Fragmente gehören zusammen, wenn ihr Identifier ohne Sequenz-Bits [4..3] gleich ist.
+Das END-Fragment trägt als letztes Byte die CRC8 (Polynom 0x31) der Nutzdaten.
+Eine Nachricht verfällt, wenn END nicht innerhalb des Timeouts nach START eintrifft.
+
+Grenzen gegen fehlerhafte oder bösartige Knoten: max. Bytes und Frames je Nachricht
+(inkl. CRC) sowie max. gleichzeitig offene Kontexte. Der Speicher ist damit auf
+maxContexts * maxBytes begrenzt, egal was auf dem Bus ankommt. */
+#ifndef CAN_REASSEMBLY_H
+#define CAN_REASSEMBLY_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+class CANReassembler {
+public:
+    enum Result : uint8_t {
+        PENDING = 0,    // Fragment übernommen, Nachricht noch unvollständig
+        COMPLETE,       // Nachricht fertig, CRC stimmt
+        CRC_ERROR,      // END empfangen, CRC falsch
+        EXPIRED,        // Fragment nach Ablauf des Timeouts, Kontext verworfen
+        ORPHAN,         // MIDDLE/END ohne vorheriges START
+        LIMIT           // Größe, Frames oder Kontexte überschritten, verworfen
+    };
+
+    struct Limits {
+        size_t maxBytes = 1024;     // je Nachricht inkl. CRC
+        uint16_t maxFrames = 160;   // je Nachricht
+        size_t maxContexts = 32;    // gleichzeitig offene Nachrichten
+    };
+
+    struct Message {
+        uint32_t baseId;            // Identifier ohne Sequenz-Bits
+        std::vector<uint8_t> data;  // Nutzdaten ohne CRC
+        int64_t firstUs;            // Zeitpunkt START
+        int64_t lastUs;             // Zeitpunkt END
+    };
+
+    explicit CANReassembler(int64_t timeoutUs = 500000) : timeoutUs_(timeoutUs) {}
+
+    void setLimits(const Limits& limits) { limits_ = limits; }
+    const Limits& limits() const { return limits_; }
+
+    // Fragment (Sequenz START, MIDDLE oder END) verarbeiten; bei COMPLETE ist out gefüllt
+    Result push(uint32_t id, const uint8_t* data, uint8_t len, int64_t nowUs, Message& out) {
+        uint8_t seq = (id >> 3) & 0x03;
+        uint32_t baseId = id & ~static_cast<uint32_t>(0x18);
+        if (len > 8) len = 8;
+        if (seq == 0) {     // START
+            auto it = map_.find(baseId);
+            if (it == map_.end()) {
+                // Voll: verfallene Kontexte räumen, sonst ablehnen
+                if (map_.size() >= limits_.maxContexts) purge(nowUs);
+                if (map_.size() >= limits_.maxContexts) return LIMIT;
+                it = map_.emplace(baseId, Entry()).first;
+            }
+            Entry& entry = it->second;
+            bytes_ -= entry.data.size();
+            entry.data.assign(data, data + len);
+            bytes_ += len;
+            entry.startUs = nowUs;
+            entry.frames = 1;
+            return PENDING;
+        }
+        auto it = map_.find(baseId);
+        if (it == map_.end()) return ORPHAN;
+        Entry& entry = it->second;
+        if (nowUs - entry.startUs > timeoutUs_) { erase(it); return EXPIRED; }
+        if (entry.frames >= limits_.maxFrames || entry.data.size() + len > limits_.maxBytes) {
+            erase(it);
+            return LIMIT;
+        }
+        ++entry.frames;
+        entry.data.insert(entry.data.end(), data, data + len);
+        bytes_ += len;
+        if (seq != 2) return PENDING;   // MIDDLE
+        // END: letztes Byte ist die CRC
+        Result r = CRC_ERROR;
+        bytes_ -= entry.data.size();
+        if (!entry.data.empty()) {
+            uint8_t recvCrc = entry.data.back();
+            entry.data.pop_back();
+            if (recvCrc == crc8(entry.data.data(), entry.data.size())) {
+                out.baseId = baseId;
+                out.data.swap(entry.data);
+                out.firstUs = entry.startUs;
+                out.lastUs = nowUs;
+                r = COMPLETE;
+            }
+        }
+        map_.erase(it);
+        return r;
+    }
+
+    // Kontexte verwerfen, deren START länger als der Timeout zurückliegt;
+    // expired(baseId) je verworfenem Kontext
+    template<typename F>
+    void purge(int64_t nowUs, F expired) {
+        for (auto it = map_.begin(); it != map_.end();) {
+            if (nowUs - it->second.startUs > timeoutUs_) {
+                expired(it->first);
+                it = erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void purge(int64_t nowUs) { purge(nowUs, [](uint32_t) {}); }
+
+    // Offene Kontexte verwerfen
+    void clear() { map_.clear(); bytes_ = 0; }
+    size_t pending() const { return map_.size(); }
+    // Summe der gepufferten Bytes aller offenen Kontexte
+    size_t buffered() const { return bytes_; }
+
+    static uint8_t crc8(const uint8_t* data, size_t len) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < len; ++i) {
+            crc ^= data[i];
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+            }
+        }
+        return crc;
+    }
+
+private:
+    struct Entry {
+        std::vector<uint8_t> data;
+        int64_t startUs = 0;
+        uint16_t frames = 0;
+    };
+
+    std::unordered_map<uint32_t, Entry>::iterator erase(std::unordered_map<uint32_t, Entry>::iterator it) {
+        bytes_ -= it->second.data.size();
+        return map_.erase(it);
+    }
+
+    int64_t timeoutUs_;
+    Limits limits_;
+    size_t bytes_ = 0;
+    std::unordered_map<uint32_t, Entry> map_;
+};
+
+#endif // CAN_REASSEMBLY_H
@@ -0,0 +1,269 @@
+/**
+Antwortzeitanalyse (Worst Case) für CAN-Nachrichten
+===================================================
+Klassische Analyse nach Davis, Burns, Bril, Lukkien (2007, revidiert) für
+nicht-präemptive Frames mit festen Prioritäten, erweitert um die Eigenheiten der
+Library. Unabhängig vom TWAI-Treiber: in der Firmware (Registry aus
+DEFINE_CAN_MESSAGE_TIMED) und im Host-Tool tools/can_rta.cpp nutzbar.
+
+Modell:
+- Frame-Dauer im Worst Case (55 + 10 * DLC) Bit (Stuff-Bits, Interframe-Space)
+- Nachrichten > 8 Byte: START/MIDDLE/END-Frames mit CRC-Byte; zwischen den Frames
+  kann höher priorisierter Verkehr arbitrieren, nur der letzte Frame ist am Stück.
+  Jeder Frame arbitriert neu, daher blockiert niedriger priorisierter Verkehr je
+  Frame einmal (nicht nur einmal je Nachricht)
+- fragmentierte Nachrichten mit ACK (setRetryLimit > 0): der Empfänger sendet je
+  Nachricht einen ACK-Frame (Type-ID 7, Priorität 3, DLC 1), Release-Jitter bis zur
+  Deadline der Nachricht, Deadline = ACK-Timeout des Senders (100 ms)
+- Busvorrang nach numerischem Identifier (kleiner gewinnt, Priorität wie in
+  CANBus::buildId invertiert: 3 = Bits 00 = höchste); unbekannte Adresse
+  (ANY_ADDR) wird für jede Nachricht ungünstigst angenommen
+- keine Busfehler, keine Wiederholungen, keine SYNC-/Bündel-Frames (bei Bedarf als
+  eigene Einträge aufnehmen) */
+#ifndef CAN_RTA_H
+#define CAN_RTA_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+class CANRta {
+public:
+    static constexpr uint8_t ANY_ADDR = 0xFF;
+    static constexpr uint8_t ACK_TYPE_ID = 0x7;
+    static constexpr uint32_t ACK_TIMEOUT_US = 100000;     // wie CANBus::waitAck
+
+    struct Message {
+        std::string name;
+        uint8_t type;
+        uint8_t prio;
+        uint8_t addr;               // Zieladresse oder ANY_ADDR
+        uint16_t bytes;             // Nutzdaten je Nachricht (inkl. Latenz-Trailer)
+        uint32_t periodUs;          // minimaler Abstand zweier Nachrichten
+        uint32_t deadlineUs;        // relativ zur Freigabe (0 = keine)
+        uint32_t jitterUs;          // Freigabe-Jitter (Task-Latenz bis send())
+        bool acked;                 // Empfänger quittiert (nur fragmentiert)
+    };
+
+    struct Result {
+        std::string name;
+        uint16_t minId;
+        uint16_t maxId;
+        uint16_t frames;
+        uint32_t transmitUs;        // C: alle Frames ohne Störung
+        uint32_t periodUs;
+        uint32_t deadlineUs;
+        uint32_t responseUs;        // Worst Case ab Freigabe bis Ende des letzten Frames
+        bool schedulable;
+    };
+
+    struct Report {
+        std::vector<Result> results;    // Nachrichten, danach ACK-Einträge ("name.ack")
+        double utilization;             // Busauslastung im Worst Case (0..1)
+        bool schedulable;
+    };
+
+    static constexpr uint16_t frameCount(size_t bytes) {
+        return bytes <= 8 ? 1 : static_cast<uint16_t>((bytes + 8) / 8);
+    }
+
+    static constexpr uint32_t frameBits(uint8_t dlc) { return 55 + 10 * static_cast<uint32_t>(dlc); }
+
+    // Übertragungsdauer aller Frames einer Nachricht in ns (constexpr für static_assert)
+    static constexpr uint64_t transmitNs(size_t bytes, uint32_t bitrate) {
+        return (bytes <= 8
+                ? frameBits(static_cast<uint8_t>(bytes))
+                : (frameCount(bytes) - 1) * frameBits(8) +
+                  frameBits(static_cast<uint8_t>(bytes + 1 - (frameCount(bytes) - 1) * 8)))
+               * 1000000000ull / bitrate;
+    }
+
+    explicit CANRta(uint32_t bitrate = 500000) : bitrate_(bitrate) {}
+
+    void add(const Message& m) { messages_.push_back(m); }
+    void add(const std::vector<Message>& ms) { messages_.insert(messages_.end(), ms.begin(), ms.end()); }
+
+    Report analyze() const {
+        std::vector<Stream> streams;
+        for (const Message& m : messages_) streams.push_back(makeStream(m));
+        for (const Message& m : messages_) {
+            if (!m.acked || m.bytes <= 8) continue;
+            Message ack;
+            ack.name = m.name + ".ack";
+            ack.type = ACK_TYPE_ID;
+            ack.prio = 3;
+            ack.addr = m.addr;
+            ack.bytes = 1;
+            ack.periodUs = m.periodUs;
+            ack.deadlineUs = ACK_TIMEOUT_US;
+            ack.jitterUs = m.deadlineUs ? m.deadlineUs : m.periodUs;
+            ack.acked = false;
+            streams.push_back(makeStream(ack));
+        }
+
+        Report rep;
+        rep.utilization = 0;
+        rep.schedulable = true;
+        for (const Stream& s : streams) rep.utilization += double(s.c) / s.t;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            const Stream& s = streams[i];
+            Result r;
+            r.name = s.msg.name;
+            r.minId = s.minId;
+            r.maxId = s.maxId;
+            r.frames = s.frames;
+            r.transmitUs = static_cast<uint32_t>(s.c / 1000);
+            r.periodUs = s.msg.periodUs;
+            r.deadlineUs = s.msg.deadlineUs;
+            int64_t resp = response(streams, i);
+            r.responseUs = resp < 0 ? UINT32_MAX : static_cast<uint32_t>((resp + 999) / 1000);
+            r.schedulable = resp >= 0 && (!s.msg.deadlineUs || r.responseUs <= s.msg.deadlineUs);
+            rep.schedulable = rep.schedulable && r.schedulable;
+            rep.results.push_back(r);
+        }
+        return rep;
+    }
+
+    // Nachrichten aus DEFINE_CAN_MESSAGE_TIMED (statische Initialisierung)
+    static std::vector<Message>& registry() {
+        static std::vector<Message> r;
+        return r;
+    }
+
+    struct Registrar {
+        Registrar(const char* name, uint8_t type, uint8_t prio, size_t bytes,
+                  uint32_t periodMs, uint32_t deadlineMs) {
+            for (const Message& m : registry())
+                if (m.name == name) return;     // Header in mehreren Übersetzungseinheiten
+            Message m;
+            m.name = name;
+            m.type = type & 0x07;
+            m.prio = prio & 0x03;
+            m.addr = ANY_ADDR;
+            m.bytes = static_cast<uint16_t>(bytes);
+            m.periodUs = periodMs * 1000;
+            m.deadlineUs = deadlineMs * 1000;
+            m.jitterUs = 0;
+            m.acked = bytes > 8;
+            registry().push_back(m);
+        }
+    };
+
+    // CSV im Eingabeformat von tools/can_rta.cpp, z. B. aus der Firmware per Serial
+    static const char* csvHeader() { return "name,type,prio,addr,bytes,period_ms,deadline_ms,jitter_ms,acked\n"; }
+
+    static void writeCsv(const std::vector<Message>& ms, const std::function<void(const char*)>& sink) {
+        sink(csvHeader());
+        for (const Message& m : ms) {
+            char line[128];
+            char addr[4] = "*";
+            if (m.addr != ANY_ADDR) snprintf(addr, sizeof(addr), "%u", m.addr);
+            snprintf(line, sizeof(line), "%s,%u,%u,%s,%u,%.3f,%.3f,%.3f,%d\n", m.name.c_str(), m.type,
+                     m.prio, addr, m.bytes, m.periodUs / 1000.0, m.deadlineUs / 1000.0,
+                     m.jitterUs / 1000.0, m.acked ? 1 : 0);
+            sink(line);
+        }
+    }
+
+private:
+    // Nachricht als Folge von Frames; Zeiten in ns
+    struct Stream {
+        Message msg;
+        uint16_t minId;             // höchste Buspriorität unter den Frames
+        uint16_t maxId;             // niedrigste
+        uint16_t frames;
+        int64_t c;                  // alle Frames
+        int64_t last;               // letzter Frame
+        int64_t maxFrame;           // längster Frame (Blockierung anderer)
+        int64_t t;
+        int64_t j;
+    };
+
+    static uint16_t buildId(uint8_t prio, uint8_t addr, uint8_t seq, uint8_t type) {
+        return static_cast<uint16_t>(((3 - (prio & 0x03)) << 9) | ((addr & 0x0F) << 5) |
+                                     ((seq & 0x03) << 3) | (type & 0x07));
+    }
+
+    int64_t frameNs(uint8_t dlc) const { return int64_t(frameBits(dlc)) * 1000000000 / bitrate_; }
+
+    Stream makeStream(const Message& m) const {
+        Stream s;
+        s.msg = m;
+        s.frames = frameCount(m.bytes);
+        const uint8_t lo = m.addr == ANY_ADDR ? 0 : m.addr;
+        const uint8_t hi = m.addr == ANY_ADDR ? 0x0F : m.addr;
+        if (s.frames == 1) {
+            s.minId = buildId(m.prio, lo, 3, m.type);
+            s.maxId = buildId(m.prio, hi, 3, m.type);
+            s.c = s.last = s.maxFrame = frameNs(static_cast<uint8_t>(m.bytes));
+        } else {
+            s.minId = buildId(m.prio, lo, 0, m.type);                       // START
+            s.maxId = buildId(m.prio, hi, 2, m.type);                       // END
+            s.last = frameNs(static_cast<uint8_t>(m.bytes + 1 - (s.frames - 1) * 8));
+            s.maxFrame = frameNs(8);
+            s.c = (s.frames - 1) * s.maxFrame + s.last;
+        }
+        s.t = std::max<int64_t>(1, int64_t(m.periodUs) * 1000);
+        s.j = int64_t(m.jitterUs) * 1000;
+        return s;
+    }
+
+    static int64_t ceilDiv(int64_t a, int64_t b) { return a <= 0 ? 0 : (a + b - 1) / b; }
+
+    // Worst-Case-Antwortzeit von streams[i] in ns (-1 = Auslastung der Stufe >= 100 %).
+    // Blockierung b: einmal vor dem ersten Frame, dazu je Lücke zwischen zwei Frames
+    // einer fragmentierten Nachricht (von m und von höher priorisierten) noch einmal
+    int64_t response(const std::vector<Stream>& streams, size_t i) const {
+        const Stream& m = streams[i];
+        const int64_t tau = 1000000000 / bitrate_;
+        // Höher priorisiert: irgendein Frame von k gewinnt gegen den letzten Frame von m
+        // (gleiche Identifier konservativ ebenfalls); alle anderen blockieren höchstens
+        // mit ihrem längsten Frame
+        std::vector<const Stream*> hp;
+        int64_t b = 0;
+        for (size_t k = 0; k < streams.size(); ++k) {
+            if (k == i) continue;
+            if (streams[k].minId <= m.maxId) hp.push_back(&streams[k]);
+            else b = std::max(b, streams[k].maxFrame);
+        }
+        auto cost = [b](const Stream& s) { return s.c + (s.frames - 1) * b; };
+        const int64_t mc = cost(m);
+        double u = double(mc) / m.t;
+        for (const Stream* k : hp) u += double(cost(*k)) / k->t;
+        if (u >= 1.0) return -1;
+        // Länge der Busy-Period der Stufe m
+        int64_t busy = mc;
+        const int64_t limit = 1000 * std::max<int64_t>(m.t, 1000000);
+        while (true) {
+            int64_t next = b + ceilDiv(busy + m.j, m.t) * mc;
+            for (const Stream* k : hp) next += ceilDiv(busy + k->j, k->t) * cost(*k);
+            if (next == busy) break;
+            if (next > limit) return -1;
+            busy = next;
+        }
+        // Jede Instanz q in der Busy-Period: Wartezeit bis zum Start des letzten Frames
+        const int64_t instances = std::max<int64_t>(1, ceilDiv(busy + m.j, m.t));
+        int64_t worst = 0;
+        for (int64_t q = 0; q < instances; ++q) {
+            int64_t w = b + q * mc + (mc - m.last);
+            while (true) {
+                int64_t next = b + q * mc + (mc - m.last);
+                for (const Stream* k : hp) next += ceilDiv(w + k->j + tau, k->t) * cost(*k);
+                if (next == w) break;
+                if (next > limit) return -1;
+                w = next;
+            }
+            worst = std::max(worst, m.j + w - q * m.t + m.last);
+        }
+        return worst;
+    }
+
+    uint32_t bitrate_;
+    std::vector<Message> messages_;
+};
+
+#endif // CAN_RTA_H
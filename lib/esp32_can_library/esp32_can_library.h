@@ -3,7 +3,7 @@ ESP32 CAN Bus Library mit TJA1050 – kompakt und konfigurierbar
 =================================================================
 
 Identifier-Schema (11 Bit):
-[10..9] 2 Bit Priorität (00: niedrig ... 11: hoch)
+[10..9] 2 Bit Priorität invertiert (prio 3: 00 gewinnt die Arbitrierung ... prio 0: 11)
 [8..5] 4 Bit Adresse (0000–1110: Node-ID, 1111: Broadcast)
 [4..3] 2 Bit Sequenz-Status (00: Start, 01: Middle, 10: End, 11: Single)
 [2..0] 3 Bit Payload-Type ID (Makro-Definition)
@@ -11,31 +11,373 @@ Identifier-Schema (11 Bit):
 Usage:
 setRetryLimit(n): Anzahl ACK-Retries (0 = kein ACK)
 onError(cb): Callback bei Sendefehler (Typ, Adresse)
+attachMailbox<T>(mb): nur neuesten Wert von T halten, Abfrage per mb.read()
+schedule<T>(prio, addr, msg, periodMs[, phaseMs]): zyklisch senden (in handleReceive)
+publish<T>(prio, addr, msg): nur bei Änderung senden (setPublishPolicy<T>, Deadband<T>),
+    mit TX-Worker wie send() aus mehreren Tasks
+startTxWorker(): send() aus mehreren Tasks über lock-freie Queue + TX-Task
+sendFromISR<T>(prio, addr, msg, &woken): aus ISR einreihen (<= 8 Byte, TX-Worker nötig)
+setDeferredDelivery(n, policy): Callbacks erst in processReceived() im Anwendungs-Task,
+    bei Rückstau nach Priorität geordnet; BLOCK wartet nur im RX-Task (startRxTask())
+setCoalescing(on, ms): kleine Nachrichten je Ziel bündeln (Type-ID 6 reserviert)
+setAutoRecovery(on): Bus-Off automatisch mit Backoff beheben; busStats(): Fehlerzähler
+onReceive<T>([](const T&, const CANBus::RxInfo&)): mit Empfangszeit erster/letzter Frame;
+    startRxTask(): Frames in eigenem Task direkt nach dem Treiber stempeln (stopRxTask() beendet ihn)
+setTimeSync(SYNC_MASTER/SYNC_SLAVE, ms): gemeinsame Zeitbasis busTimeUs() über den Bus
+DEFINE_CAN_MESSAGE_TIMED(Name, id, prio, periodMs, deadlineMs, ...): Worst-Case-Antwortzeiten
+    per CANRta (can_rta.h) oder tools/can_rta.cpp
+setTimeTriggered(cycleUs, windows) / scheduleInWindow<T>: exklusive Sendefenster, send() nur
+    in Arbitrierungsfenstern (braucht setTimeSync)
+dumpLatency(sink): Ende-zu-Ende-Latenz je Typ und Quelle (CANBUS_LATENCY_TRACE, setNodeAddress)
+dumpProfile(sink): Zyklen-Histogramme für TX/RX/Reassembly/CRC/Dispatch (CANBUS_PROFILING)
+setClock(fn): Zeitquelle (Default esp_timer_get_time, Tests: CANBus::VirtualClock::now)
+setReassemblyLimits(bytes, frames, ctx): Speicher für Fragmente begrenzen (Default 1024/160/32)
+exportCandump(sink) / exportPcap(sink): letzte Frames (TX+RX) aus dem Trace-Ring
+    (CANBUS_TRACE_SIZE, z. B. 64; ohne das Makro leer)
+startCapture(sink): Listen-Only-Mitschnitt in Blöcke (can_capture.h), z. B. partitionSink()
+injectFrame(id, data, dlc, timeUs): Frame ohne Treiber empfangen (Replay, tools/capture_replay.h)
+setFaults(dir, profile) / setFaultScript / injectBusState: Fehler einspielen (CANBUS_FAULT_INJECTION)
 Default: RetryLimit=3 */
 #ifndef ESP32_CAN_LIBRARY_H
 #define ESP32_CAN_LIBRARY_H
 
 #include <driver/twai.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <vector>
 #include <unordered_map>
 #include <functional>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
+#include <type_traits>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdio>
+#include "can_capture.h"
+#include "can_reassembly.h"
+#include "can_rta.h"
+#if CANBUS_PROFILING && !defined(__XTENSA__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#elif CANBUS_PROFILING && !defined(__XTENSA__)
 #include <chrono>
+#endif
+
+// Max. Nachrichtengröße (Byte) für die TX-Queue des Worker-Tasks
+#ifndef CANBUS_TX_SLOT_SIZE
+#define CANBUS_TX_SLOT_SIZE 64
+#endif
+// Max. Nachrichtengröße (Byte) für die Übergabe-Queue RX → Anwendung
+#ifndef CANBUS_RX_SLOT_SIZE
+#define CANBUS_RX_SLOT_SIZE 64
+#endif
+// BLOCK: max. Wartezeit (ms) des RX-Tasks auf einen freien Slot, danach verworfen
+#ifndef CANBUS_RX_BLOCK_MS
+#define CANBUS_RX_BLOCK_MS 100
+#endif
+// Einträge im Frame-Trace (Zweierpotenz, 0 = kein Trace). Kostet 24 Byte RAM je Eintrag
+// und CANBus-Instanz (64: 1,5 KB, 512: 12 KB), daher standardmäßig aus
+#ifndef CANBUS_TRACE_SIZE
+#define CANBUS_TRACE_SIZE 0
+#endif
+// Cache-Line-Größe für das Auffüllen von Ring-Indizes (ESP32: 32 Byte)
+#ifndef CANBUS_CACHE_LINE
+#define CANBUS_CACHE_LINE 32
+#endif
+// Zyklenzähler-Histogramme je Stufe (1 = profile()/dumpProfile() verfügbar, 0 = kein Code)
+#ifndef CANBUS_PROFILING
+#define CANBUS_PROFILING 0
+#endif
+// Latenzmessung über Knoten hinweg: Nachrichten tragen 3 Byte Sendezeit + Quelle, sofern
+// das keinen Frame zusätzlich kostet (sonst ungestempelt, siehe CANBus::TxLayout).
+// Ändert das Frame-Format, muss auf allen Knoten gleich gesetzt sein.
+#ifndef CANBUS_LATENCY_TRACE
+#define CANBUS_LATENCY_TRACE 0
+#endif
+// Fault-Injection für Tests (1 = setFaults() & Co. verfügbar, kostet im Betrieb nichts wenn 0)
+#ifndef CANBUS_FAULT_INJECTION
+#define CANBUS_FAULT_INJECTION 0
+#endif
+
+// Messpunkt für den umgebenden Block (nur innerhalb von CANBus)
+#if CANBUS_PROFILING
+#define CANBUS_PROFILE(stage) ProfileScope canbusProfile_(profile_[stage])
+#else
+#define CANBUS_PROFILE(stage) do {} while (0)
+#endif
 
 class CANBus {
 public:
     enum Sequence : uint8_t { START=0, MIDDLE=1, END=2, SINGLE=3 };
+    // Verhalten der RX-Übergabe-Queue, wenn die Anwendung nicht nachkommt
+    enum Backpressure : uint8_t { DROP_OLDEST=0, DROP_NEWEST=1, BLOCK=2 };
     static constexpr uint32_t REASSEMBLY_TIMEOUT = 500;
     static constexpr uint8_t  ACK_TYPE_ID = 0x7;
+    static constexpr uint8_t  BUNDLE_TYPE_ID = 0x6;   // reserviert, wenn Coalescing aktiv ist
+    static constexpr uint32_t AUTO_PHASE = 0xFFFFFFFF;
+    static constexpr size_t   INVALID_HANDLE = SIZE_MAX;
+    // Trailer hinter den Nutzdaten (nicht bei gebündelten Nachrichten):
+    // [Sendezeit/16 µs, 16 Bit LE][Quellknoten]
+    static constexpr size_t   LATENCY_TRAILER = CANBUS_LATENCY_TRACE ? 3 : 0;
+
+    // Frames für n Byte Nutzdaten: Einzelframe bis 8 Byte, sonst Fragmente + CRC-Byte
+    static constexpr size_t framesFor(size_t n) { return n <= 8 ? 1 : (n + 8) / 8; }
+
+    // Layout von T auf dem Bus: der Latenz-Trailer kommt nur dazu, wenn die Frameanzahl
+    // gleich bleibt. Sonst würde er z. B. 6..8-Byte-Nachrichten in den fragmentierten Pfad
+    // mit ACK schieben; solche Nachrichten gehen ungestempelt (latencyUnstamped()).
+    template<typename T>
+    struct TxLayout {
+        static constexpr size_t trailer =
+            framesFor(sizeof(T) + LATENCY_TRAILER) == framesFor(sizeof(T)) ? LATENCY_TRAILER : 0;
+        static constexpr size_t len = sizeof(T) + trailer;
+        static constexpr bool single = len <= 8;
+    };
 
     using ErrorCallback = std::function<void(uint8_t type, uint8_t address)>;
+    using AlertCallback = std::function<void(uint32_t alerts)>;
+    // Ausgabe für Exporte (z. B. Serial.write oder Datei)
+    using TraceSink = std::function<void(const uint8_t* data, size_t len)>;
+
+    // Ausgabe für Capture-Blöcke (CANCapture::BLOCK_SIZE Byte), läuft im Writer-Task
+    using CaptureSink = std::function<esp_err_t(const uint8_t* block, size_t len)>;
+
+    struct CaptureStats {
+        uint32_t frames;            // aufgezeichnet
+        uint32_t blocks;            // geschrieben
+        uint32_t droppedFrames;     // kein freier Puffer (Senke zu langsam)
+        uint32_t sinkErrors;
+    };
+
+    // Ein Eintrag im Frame-Trace
+    enum TraceDir : uint8_t { TRACE_RX=0, TRACE_TX=1 };
+    struct TraceEntry {
+        int64_t  timeUs;
+        uint32_t identifier;
+        uint8_t  dlc;
+        uint8_t  dir;
+        uint8_t  data[8];
+    };
+
+    // Treiberzähler (twai_get_status_info) plus von der Library gezählte Ereignisse
+    struct BusStats {
+        twai_state_t state;
+        uint32_t txErrorCounter;
+        uint32_t rxErrorCounter;
+        uint32_t txFailed;
+        uint32_t rxMissed;          // RX-Queue des Treibers voll
+        uint32_t rxOverrun;         // Hardware-FIFO übergelaufen
+        uint32_t arbLost;
+        uint32_t busErrors;
+        uint32_t rxQueueFull;       // Anzahl RX_QUEUE_FULL-Alerts
+        uint32_t errorPassive;      // Übergänge nach Error-Passive
+        uint32_t busOff;            // Übergänge nach Bus-Off
+        uint32_t recoveries;        // erfolgreich wiederhergestellt
+        uint32_t lastRecoveryMs;    // Bus-Off → wieder RUNNING
+        uint32_t maxRecoveryMs;
+        uint32_t reassemblyLimit;   // wegen Reassembly-Grenzen verworfene Nachrichten
+        uint32_t queuedTxFailed;    // vom TX-Worker nicht gesendete Nachrichten
+    };
+
+    // Histogramm mit logarithmischen Klassen: je Zweierpotenz 4 Unterklassen (Fehler < 25 %),
+    // Werte 0..2^32. Zählt lock-frei, darf aus mehreren Tasks befüllt werden.
+    class Histogram {
+    public:
+        static constexpr size_t BUCKETS = 124;
+
+        void record(uint32_t v) {
+            counts_[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(v, std::memory_order_relaxed);
+            uint32_t m = max_.load(std::memory_order_relaxed);
+            while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+            m = min_.load(std::memory_order_relaxed);
+            while (v < m && !min_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+        }
+
+        uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+        uint32_t min() const { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+        uint32_t max() const { return max_.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+        // Untergrenze der Klasse, in die das p-Quantil (0..1) fällt
+        uint32_t percentile(float p) const {
+            uint32_t n = count();
+            if (!n) return 0;
+            uint64_t rank = static_cast<uint64_t>(p * n);
+            if (rank >= n) rank = n - 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += counts_[i].load(std::memory_order_relaxed);
+                if (seen > rank) return std::max(lowerBound(i), min());
+            }
+            return max();
+        }
+
+        void reset() {
+            for (std::atomic<uint32_t>& c : counts_) c.store(0, std::memory_order_relaxed);
+            count_.store(0);
+            sum_.store(0);
+            min_.store(UINT32_MAX);
+            max_.store(0);
+        }
+
+        static size_t bucket(uint32_t v) {
+            if (v < 4) return v;
+            uint32_t msb = 31 - __builtin_clz(v);
+            return (msb - 1) * 4 + ((v >> (msb - 2)) & 3);
+        }
+
+        static uint32_t lowerBound(size_t i) {
+            if (i < 4) return static_cast<uint32_t>(i);
+            uint32_t msb = static_cast<uint32_t>(i / 4 + 1);
+            return (1u << msb) | (static_cast<uint32_t>(i % 4) << (msb - 2));
+        }
+
+    private:
+        std::atomic<uint32_t> counts_[BUCKETS] = {};
+        std::atomic<uint32_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint32_t> min_{UINT32_MAX};
+        std::atomic<uint32_t> max_{0};
+    };
+
+#if CANBUS_PROFILING
+    // Messpunkte im heißen Pfad. RX umfasst Reassembly und Dispatch; die CRC des
+    // Empfängers steckt in REASSEMBLY, CRC misst die Sendeseite.
+    enum ProfileStage : uint8_t { PROF_TX = 0, PROF_RX, PROF_REASSEMBLY, PROF_CRC, PROF_DISPATCH, PROF_STAGES };
+
+    // Zyklen: CCOUNT auf Xtensa (1 Zyklus = 1/CPU-Takt), rdtsc auf x86, sonst ns
+    static uint32_t cycles() {
+#if defined(__XTENSA__)
+        uint32_t c;
+        asm volatile("rsr %0, ccount" : "=a"(c));
+        return c;
+#elif defined(__x86_64__) || defined(__i386__)
+        return static_cast<uint32_t>(__rdtsc());
+#else
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    const Histogram& profile(ProfileStage stage) const { return profile_[stage]; }
+    void resetProfile() { for (Histogram& h : profile_) h.reset(); }
+
+    // Eine Textzeile je Stufe: Anzahl, min, p50, p90, p99, max, Mittel (Zyklen)
+    size_t dumpProfile(const TraceSink& sink) const {
+        static const char* const names[PROF_STAGES] = {"tx", "rx", "reassembly", "crc", "dispatch"};
+        char line[128];
+        int len = snprintf(line, sizeof(line), "stage count min p50 p90 p99 max avg\n");
+        sink(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(len));
+        for (uint8_t s = 0; s < PROF_STAGES; ++s) {
+            const Histogram& h = profile_[s];
+            len = snprintf(line, sizeof(line), "%s %u %u %u %u %u %u %u\n", names[s],
+                           unsigned(h.count()), unsigned(h.min()), unsigned(h.percentile(0.5f)),
+                           unsigned(h.percentile(0.9f)), unsigned(h.percentile(0.99f)),
+                           unsigned(h.max()), unsigned(h.count() ? h.sum() / h.count() : 0));
+            sink(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(len));
+        }
+        return PROF_STAGES;
+    }
+#endif
 
     template<typename T, uint8_t TYPE_ID>
     struct MsgTraits { using type = T; static constexpr uint8_t TypeID = TYPE_ID; };
 
-    // Konstruktion: TX/RX Pins, Bus-Modus, Baudrate
+    // Type-ID je Nachrichtentyp, von DEFINE_CAN_MESSAGE spezialisiert (undefiniert für
+    // Typen ohne Definition: Compile-Fehler statt stiller Type-ID 0)
+    template<typename T>
+    struct MsgType;
+
+    // Seqlock-Leser: nach SEQLOCK_SPINS erfolglosen Versuchen einen Tick schlafen, damit ein
+    // niedriger priorisierter, unterbrochener Schreiber auf demselben Kern fertig wird
+    static constexpr uint32_t SEQLOCK_SPINS = 64;
+    static void seqlockBackoff(uint32_t& spins) {
+        if (++spins < SEQLOCK_SPINS) return;
+        spins = 0;
+        vTaskDelay(1);
+    }
+
+    // Mailbox: hält nur den neuesten Wert eines Typs (Seqlock, ein Schreiber = RX-Pfad).
+    // Leser pollen in ihrem eigenen Takt, ohne den Empfang zu bremsen (nicht aus ISRs).
+    template<typename T>
+    class Mailbox {
+    public:
+        // Neuesten Wert lesen; false, solange noch nichts empfangen wurde.
+        // stampUs: Empfangszeit in µs (Zeitquelle des CANBus, siehe setClock)
+        bool read(T& out, int64_t* stampUs = nullptr, uint32_t* updates = nullptr) const {
+            uint32_t spins = 0;
+            while (true) {
+                uint32_t s1 = seq_.load(std::memory_order_acquire);
+                if (s1 & 1) {                   // Schreiber aktiv
+                    seqlockBackoff(spins);
+                    continue;
+                }
+                T v;
+                memcpy(&v, &value_, sizeof(T));
+                int64_t ts = stamp_;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) != s1) {
+                    seqlockBackoff(spins);
+                    continue;
+                }
+                if (s1 == 0) return false;
+                out = v;
+                if (stampUs) *stampUs = ts;
+                if (updates) *updates = s1 / 2;
+                return true;
+            }
+        }
+
+        // Anzahl bisher empfangener Werte (günstig zum Pollen auf Änderungen)
+        uint32_t updates() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+    private:
+        friend class CANBus;
+        void write(const uint8_t* data, int64_t ts) {
+            uint32_t s = seq_.load(std::memory_order_relaxed);
+            seq_.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&value_, data, sizeof(T));
+            stamp_ = ts;
+            seq_.store(s + 2, std::memory_order_release);
+        }
+
+        std::atomic<uint32_t> seq_{0};
+        T value_;
+        int64_t stamp_ = 0;
+    };
+
+    // Änderungskriterium für publish(): Deadband je Feld, z. B.
+    // Deadband<TempHumMsg>().field(&TempHumMsg::temperature, 0.2f)
+    template<typename T>
+    class Deadband {
+    public:
+        template<typename F, typename B>
+        Deadband& field(F T::*member, B band) {
+            checks_.push_back([member, band](const T& last, const T& now) {
+                F d = (now.*member > last.*member) ? F(now.*member - last.*member)
+                                                   : F(last.*member - now.*member);
+                return d > band;
+            });
+            return *this;
+        }
+        // true, wenn mindestens ein Feld sein Deadband überschreitet
+        bool operator()(const T& last, const T& now) const {
+            for (const auto& c : checks_) if (c(last, now)) return true;
+            return false;
+        }
+    private:
+        std::vector<std::function<bool(const T&, const T&)>> checks_;
+    };
+
+    // Konstruktion: TX/RX Pins, Bus-Modus, Baudrate (25 kbit/s .. 1 Mbit/s wie die
+    // TWAI_TIMING_CONFIG_*-Makros, sonst liefert init() ESP_ERR_INVALID_ARG)
     CANBus(gpio_num_t tx_pin, gpio_num_t rx_pin,
            twai_mode_t mode = TWAI_MODE_NORMAL, uint32_t baud = 500000)
       : retryLimit_(3), errorCb_(nullptr)
@@ -47,147 +389,2096 @@ public:
         config_.bus_off_io = GPIO_NUM_NC;
         config_.tx_queue_len = 10;
         config_.rx_queue_len = 10;
-        config_.alerts_enabled = TWAI_ALERT_NONE;
+        config_.alerts_enabled = TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_OFF |
+                                 TWAI_ALERT_BUS_RECOVERED | TWAI_ALERT_RX_QUEUE_FULL |
+                                 TWAI_ALERT_ERR_ACTIVE;
+#ifdef TWAI_ALERT_RX_FIFO_OVERRUN
+        config_.alerts_enabled |= TWAI_ALERT_RX_FIFO_OVERRUN;
+#endif
         config_.clkout_divider = 0;
-        timing_ = TWAI_TIMING_CONFIG_500KBITS();
+        bitrate_ = timingFor(baud, timing_) ? baud : 0;
         filter_.acceptance_code = 0;
         filter_.acceptance_mask = 0;
         filter_.single_filter = true;
+        publishLock_ = xSemaphoreCreateMutex();
+#if CANBUS_FAULT_INJECTION
+        faultLock_ = xSemaphoreCreateMutex();
+#endif
+    }
+
+    ~CANBus() {
+        if (ackSem_) vSemaphoreDelete(ackSem_);
+        if (publishLock_) vSemaphoreDelete(publishLock_);
+#if CANBUS_FAULT_INJECTION
+        if (faultLock_) vSemaphoreDelete(faultLock_);
+#endif
     }
 
     // Driver installieren und starten
     esp_err_t init() {
+        if (!bitrate_) return ESP_ERR_INVALID_ARG;
+        if (!ackSem_ && !(ackSem_ = xSemaphoreCreateBinary())) return ESP_ERR_NO_MEM;
         esp_err_t err = twai_driver_install(&config_, &timing_, &filter_);
         if (err != ESP_OK) return err;
         return twai_start();
     }
 
+    uint32_t bitrate() const { return bitrate_; }
+
+    // Länge der Treiber-Queues (vor init() aufrufen; Capture: RX >= 64 empfohlen)
+    void setQueueLength(uint32_t tx, uint32_t rx) {
+        config_.tx_queue_len = tx;
+        config_.rx_queue_len = rx;
+    }
+
+    // Monotone Zeitquelle in µs für alle Timeouts, Zyklen und Zeitstempel.
+    // Default esp_timer_get_time (64-Bit-Timer, billig); für Host-Tests VirtualClock::now.
+    using ClockFn = int64_t (*)();
+    void setClock(ClockFn clock) { clock_ = clock ? clock : &esp_timer_get_time; }
+    int64_t nowUs() const { return clock_(); }
+
+    // Virtuelle Zeit für deterministische Tests und Simulationen (gemeinsam für alle
+    // Instanzen). Steht, bis sie gesetzt oder vorgestellt wird; mit setStep(us) läuft sie
+    // je Abfrage um us weiter, damit Warteschleifen wie das ACK-Warten enden.
+    struct VirtualClock {
+        static int64_t now() { return time().fetch_add(step().load(std::memory_order_relaxed)); }
+        static void set(int64_t us) { time().store(us); }
+        static void advance(int64_t us) { time().fetch_add(us); }
+        static void setStep(int64_t us) { step().store(us); }
+
+    private:
+        static std::atomic<int64_t>& time() { static std::atomic<int64_t> t{0}; return t; }
+        static std::atomic<int64_t>& step() { static std::atomic<int64_t> s{0}; return s; }
+    };
+
     // Anzahl der ACK-Retries setzen (0 = kein ACK erwartet)
     void setRetryLimit(uint8_t n) { retryLimit_ = n; }
-    // Callback bei Sendefehler
+
+    // Eigene Knotenadresse (0–14), wird u. a. als Quelle im Latenz-Trailer gesendet
+    void setNodeAddress(uint8_t addr) { nodeAddress_ = addr & 0x0F; }
+    uint8_t nodeAddress() const { return nodeAddress_; }
+
+    // Zeitsynchronisation (Type-ID 7, data[0] >= 0x80): der Master sendet alle periodMs
+    // SYNC an Broadcast (15) als Self-Reception und stempelt den eigenen Empfang wie die
+    // Slaves; FOLLOW_UP trägt diesen Zeitpunkt. Slaves bestimmen daraus Offset und Drift
+    // ihrer Uhr; busTimeUs() liefert danach die Master-Zeit. Die Genauigkeit ist durch die
+    // Task-Latenz beim Stempeln begrenzt (handleReceive eng pollen oder startRxTask()).
+    enum SyncRole : uint8_t { SYNC_OFF = 0, SYNC_MASTER, SYNC_SLAVE };
+    static constexpr uint8_t SYNC_CODE = 0x80;
+    static constexpr uint8_t FOLLOW_UP_CODE = 0x81;
+
+    struct TimeSyncStatus {
+        bool synced;
+        int64_t offsetUs;           // Master-Zeit minus lokale Zeit
+        int32_t driftPpb;           // Gangabweichung der lokalen Uhr (+ = zu langsam)
+        int64_t lastErrorUs;        // Vorhersagefehler beim letzten Sync
+        uint32_t syncs;             // ausgewertete SYNC/FOLLOW_UP-Paare
+        uint32_t resets;            // Neustarts des Servos (Sprung, Lücke > SYNC_MAX_INTERVAL_US)
+    };
+
+    // Größerer Vorhersagefehler (z. B. Master-Neustart) oder längere Lücke zwischen zwei
+    // Syncs: Offset direkt übernehmen, Drift neu schätzen
+    static constexpr int64_t SYNC_RESET_US = 100000;
+    static constexpr int64_t SYNC_MAX_INTERVAL_US = 60000000;
+
+    void setTimeSync(SyncRole role, uint32_t periodMs = 1000) {
+        syncRole_ = role;
+        syncPeriodUs_ = static_cast<int64_t>(std::max<uint32_t>(periodMs, 1)) * 1000;
+        syncDue_ = nowUs();
+        syncSeq_.store(0);
+        syncStatus_ = TimeSyncStatus{};
+        driftSamples_ = 0;
+        syncEcho_.store(-1);
+    }
+
+    TimeSyncStatus timeSyncStatus() const {
+        TimeSyncStatus st = syncStatus_;
+        if (st.synced) st.offsetUs = busTimeUs() - nowUs();
+        return st;
+    }
+
+    // Gemeinsame Zeitbasis in µs: Master und unsynchronisierte Knoten lokale Uhr,
+    // synchronisierte Slaves die Master-Zeit. Für Zeitstempel an der Quelle.
+    int64_t busTimeUs() const {
+        if (syncRole_ != SYNC_SLAVE) return nowUs();
+        SyncPoint p;
+        if (!readSyncPoint(p)) return nowUs();
+        return toMasterTime(p, nowUs());
+    }
+
+    // Zeitgesteuertes Senden (TT) auf busTimeUs(): ein Zyklus von cycleUs wiederholt sich
+    // ab Zeit 0, alle Knoten brauchen dieselbe Fenstertabelle und setTimeSync(). In einem
+    // EXCLUSIVE-Fenster sendet nur der Knoten node seine per scheduleInWindow() zugeordneten
+    // Nachrichten, ohne Arbitrierung gegen andere. Alle übrigen Frames (send, schedule,
+    // ACKs, SYNC) starten nur, wenn sie vollständig in ein ARBITRATION-Fenster passen
+    // (Worst Case (55 + 10 * DLC) Bit), und warten sonst darauf. Fragmentierte Nachrichten
+    // können sich über mehrere Fenster verteilen. Ohne Sync (Slave) wird nichts gesendet.
+    // Frame-Dauer nach der Baudrate aus dem Konstruktor.
+    enum WindowKind : uint8_t { WINDOW_EXCLUSIVE = 0, WINDOW_ARBITRATION };
+
+    struct TxWindow {
+        uint32_t startUs;           // Beginn relativ zum Zyklusanfang
+        uint32_t lengthUs;
+        WindowKind kind;
+        uint8_t node;               // EXCLUSIVE: sendender Knoten (setNodeAddress)
+    };
+
+    struct TimeTriggeredStats {
+        uint32_t sent;              // in exklusiven Fenstern gesendete Nachrichten
+        uint32_t missed;            // Fenster verpasst (zu spät, nicht synchronisiert)
+        uint32_t deferred;          // Frames, die auf ein Arbitrierungsfenster warten mussten
+    };
+
+    // Höchste Baudrate; Compile-Zeit-Prüfung in DEFINE_CAN_MESSAGE_TIMED (Best Case)
+    static constexpr uint32_t MAX_BITRATE = 1000000;
+
+    // Worst-Case-Dauer eines Standard-Frames inkl. Stuff-Bits und Interframe-Space
+    uint32_t frameUs(uint8_t dlc) const {
+        return (55 + 10 * static_cast<uint32_t>(dlc)) * 1000000 / bitrate_;
+    }
+
+    // Vor dem Betrieb aufrufen (vor startTxWorker(), nicht während send() aus anderen Tasks).
+    // ESP_ERR_INVALID_STATE auch bei nicht unterstützter Baudrate (Frame-Dauer unbekannt).
+    esp_err_t setTimeTriggered(uint32_t cycleUs, const std::vector<TxWindow>& windows) {
+        if (outsideWorker() || !bitrate_) return ESP_ERR_INVALID_STATE;
+        if (cycleUs == 0) return ESP_ERR_INVALID_ARG;
+        for (const TxWindow& w : windows)
+            if (w.lengthUs == 0 || w.startUs + w.lengthUs > cycleUs) return ESP_ERR_INVALID_ARG;
+        ttWindows_ = windows;
+        ttEntries_.clear();
+        ttCycleUs_ = cycleUs;
+        return ESP_OK;
+    }
+
+    void clearTimeTriggered() {
+        ttCycleUs_ = 0;
+        ttWindows_.clear();
+        ttEntries_.clear();
+    }
+
+    // msg in jedem Zyklus zu Beginn des exklusiven Fensters window senden (per Referenz
+    // gehalten wie bei schedule()). Die Nachricht muss samt Fragmenten in das Fenster
+    // passen; ohne Coalescing und mit setRetryLimit(0) für fragmentierte Nachrichten, da
+    // ACKs erst im nächsten Arbitrierungsfenster kommen.
+    template<typename T>
+    esp_err_t scheduleInWindow(uint8_t prio, uint8_t addr, const T& msg, size_t window) {
+        static_assert(std::is_standard_layout<T>::value, "T must be POD");
+        constexpr size_t len = TxLayout<T>::len;
+        constexpr size_t frames = framesFor(len);
+        constexpr size_t last = len <= 8 ? len : len + 1 - (frames - 1) * 8;
+        if (!ttCycleUs_ || !bitrate_ || window >= ttWindows_.size() || outsideWorker())
+            return ESP_ERR_INVALID_STATE;
+        const TxWindow& w = ttWindows_[window];
+        if (w.kind != WINDOW_EXCLUSIVE || w.node != nodeAddress_) return ESP_ERR_INVALID_ARG;
+        const uint32_t duration = (frames - 1) * frameUs(8) + frameUs(last);
+        if (duration > w.lengthUs) return ESP_ERR_INVALID_SIZE;
+        TTEntry e;
+        e.tx = [this, prio, addr, &msg]() { return send<T>(prio, addr, msg); };
+        e.window = window;
+        e.latestUs = w.lengthUs - duration;
+        ttEntries_.push_back(e);
+        return ESP_OK;
+    }
+
+    TimeTriggeredStats timeTriggeredStats() const {
+        return TimeTriggeredStats{ttSent_, ttMissed_, ttDeferred_.load()};
+    }
+
+#if CANBUS_LATENCY_TRACE
+    // Latenz Sendebeginn beim Erzeuger → Aufruf des Handlers beim Empfänger in µs, je Type-ID
+    // und je Quellknoten. Zeitbasis ist busTimeUs() (setTimeSync auf allen Knoten); Auflösung
+    // 16 µs, eindeutig bis ca. 1 s. Wartezeit in der TX-Queue des Workers zählt nicht mit.
+    const Histogram& latencyByType(uint8_t type) const { return latencyType_[type & 0x07]; }
+    const Histogram& latencyBySource(uint8_t node) const { return latencySource_[node & 0x0F]; }
+
+    // Nachrichten mit Latenz > deadlineUs zählen (0 = aus)
+    void setLatencyDeadline(uint32_t deadlineUs) { latencyDeadline_ = deadlineUs; }
+    uint32_t latencyMisses(uint8_t type) const { return latencyMisses_[type & 0x07].load(); }
+
+    // Empfangene Nachrichten ohne Trailer (Typ mit Handler; Trailer hätte beim Sender einen
+    // Frame mehr gekostet, siehe TxLayout). Gebündelte Nachrichten zählen nicht mit.
+    uint32_t latencyUnstamped(uint8_t type) const { return latencyUnstamped_[type & 0x07].load(); }
+
+    void resetLatency() {
+        for (Histogram& h : latencyType_) h.reset();
+        for (Histogram& h : latencySource_) h.reset();
+        for (std::atomic<uint32_t>& m : latencyMisses_) m.store(0);
+        for (std::atomic<uint32_t>& m : latencyUnstamped_) m.store(0);
+    }
+
+    // Eine Textzeile je Type-ID bzw. Quelle mit Messwerten (µs); Rückgabe: Anzahl Zeilen
+    size_t dumpLatency(const TraceSink& sink) const {
+        char line[128];
+        size_t n = 0;
+        int len = snprintf(line, sizeof(line), "key count min p50 p90 p99 max misses unstamped\n");
+        sink(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(len));
+        auto put = [&](const char* key, unsigned id, const Histogram& h, long misses, long unstamped) {
+            if (!h.count() && unstamped <= 0) return;
+            len = snprintf(line, sizeof(line), "%s%u %u %u %u %u %u %u %ld %ld\n", key, id,
+                           unsigned(h.count()), unsigned(h.min()), unsigned(h.percentile(0.5f)),
+                           unsigned(h.percentile(0.9f)), unsigned(h.percentile(0.99f)),
+                           unsigned(h.max()), misses, unstamped);
+            sink(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(len));
+            ++n;
+        };
+        for (uint8_t t = 0; t < 8; ++t)
+            put("type", t, latencyType_[t], long(latencyMisses_[t].load()), long(latencyUnstamped_[t].load()));
+        for (uint8_t a = 0; a < 16; ++a) put("node", a, latencySource_[a], -1, -1);
+        return n;
+    }
+#endif
+
+    // Grenzen der Fragment-Reassembly (Bytes und Frames je Nachricht inkl. CRC, offene
+    // Nachrichten gleichzeitig). Schützt den Heap vor Knoten, die endlos MIDDLE-Frames
+    // oder ständig neue STARTs senden. Verworfenes zählt busStats().reassemblyLimit.
+    void setReassemblyLimits(size_t maxBytes, uint16_t maxFrames, size_t maxContexts) {
+        CANReassembler::Limits l;
+        l.maxBytes = maxBytes;
+        l.maxFrames = maxFrames;
+        l.maxContexts = maxContexts;
+        reassembler_.setLimits(l);
+    }
+    // Callback bei Sendefehler: ACK-Retries erschöpft, mit TX-Worker auch jeder andere
+    // Fehler einer eingereihten Nachricht (läuft dann im Worker-Task)
     void onError(ErrorCallback cb) { errorCb_ = cb; }
 
+    // Automatische Bus-Off-Recovery: nach Bus-Off backoff abwarten, dann
+    // twai_initiate_recovery() und twai_start(). Backoff verdoppelt sich bei erneutem
+    // Bus-Off bis maxBackoffMs und fällt nach maxBackoffMs stabilem Betrieb zurück.
+    void setAutoRecovery(bool enable, uint32_t initialBackoffMs = 10, uint32_t maxBackoffMs = 1000) {
+        autoRecovery_ = enable;
+        backoffInitial_ = initialBackoffMs;
+        backoffMax_ = std::max(initialBackoffMs, maxBackoffMs);
+        backoff_ = initialBackoffMs;
+    }
+
+    // Callback für Treiber-Alerts (Bitmaske TWAI_ALERT_*), läuft in handleReceive
+    void onBusAlert(AlertCallback cb) { alertCb_ = cb; }
+
+    // Aktuelle Zähler und Zustand
+    BusStats busStats() {
+        twai_status_info_t info{};
+        if (twai_get_status_info(&info) == ESP_OK) {
+            stats_.state = info.state;
+            stats_.txErrorCounter = info.tx_error_counter;
+            stats_.rxErrorCounter = info.rx_error_counter;
+            stats_.txFailed = info.tx_failed_count;
+            stats_.rxMissed = info.rx_missed_count;
+            stats_.rxOverrun = info.rx_overrun_count;
+            stats_.arbLost = info.arb_lost_count;
+            stats_.busErrors = info.bus_error_count;
+        }
+#if CANBUS_FAULT_INJECTION
+        if (faultState_.load() == FAULT_BUS_OFF) {
+            stats_.state = TWAI_STATE_BUS_OFF;
+            stats_.txErrorCounter = 256;
+        } else if (faultState_.load() == FAULT_ERROR_PASSIVE) {
+            stats_.txErrorCounter = std::max<uint32_t>(stats_.txErrorCounter, 128);
+        }
+#endif
+        stats_.queuedTxFailed = queuedTxFailed_.load(std::memory_order_relaxed);
+        return stats_;
+    }
+
+    // Frame-Trace: die letzten CANBUS_TRACE_SIZE gesendeten und empfangenen Frames
+    // (Default 0: kein Trace, beide Exporte liefern dann 0 Frames).
+    // Export im candump-Logformat (-L) bzw. als pcap (LINKTYPE_CAN_SOCKETCAN, Wireshark).
+    // Rückgabe: Anzahl exportierter Frames
+    size_t exportCandump(const TraceSink& sink, const char* iface = "can0") const {
+        size_t n = 0;
+        forEachTrace([&](const TraceEntry& e) {
+            char line[96];
+            int len = snprintf(line, sizeof(line), "(%lld.%06lld) %.16s %03X#",
+                               static_cast<long long>(e.timeUs / 1000000),
+                               static_cast<long long>(e.timeUs % 1000000),
+                               iface, static_cast<unsigned>(e.identifier & 0x7FF));
+            for (uint8_t i = 0; i < e.dlc && i < 8; ++i)
+                len += snprintf(line + len, sizeof(line) - len, "%02X", e.data[i]);
+            line[len++] = '\n';
+            sink(reinterpret_cast<const uint8_t*>(line), len);
+            ++n;
+        });
+        return n;
+    }
+
+    size_t exportPcap(const TraceSink& sink) const {
+        uint8_t hdr[24];
+        putLe32(hdr, 0xA1B2C3D4);       // Magic, Zeitstempel in µs
+        putLe16(hdr + 4, 2);            // Version 2.4
+        putLe16(hdr + 6, 4);
+        putLe32(hdr + 8, 0);            // Zeitzone
+        putLe32(hdr + 12, 0);           // Genauigkeit
+        putLe32(hdr + 16, 16);          // Snaplen = struct can_frame
+        putLe32(hdr + 20, 227);         // LINKTYPE_CAN_SOCKETCAN
+        sink(hdr, sizeof(hdr));
+        size_t n = 0;
+        forEachTrace([&](const TraceEntry& e) {
+            uint8_t rec[16 + 16];
+            putLe32(rec, static_cast<uint32_t>(e.timeUs / 1000000));
+            putLe32(rec + 4, static_cast<uint32_t>(e.timeUs % 1000000));
+            putLe32(rec + 8, 16);
+            putLe32(rec + 12, 16);
+            // struct can_frame: can_id in Network-Byte-Order (Big Endian)
+            uint32_t id = e.identifier & 0x7FF;
+            rec[16] = static_cast<uint8_t>(id >> 24);
+            rec[17] = static_cast<uint8_t>(id >> 16);
+            rec[18] = static_cast<uint8_t>(id >> 8);
+            rec[19] = static_cast<uint8_t>(id);
+            rec[20] = e.dlc;
+            rec[21] = rec[22] = rec[23] = 0;
+            memset(rec + 24, 0, 8);
+            memcpy(rec + 24, e.data, std::min<uint8_t>(e.dlc, 8));
+            sink(rec, sizeof(rec));
+            ++n;
+        });
+        return n;
+    }
+
+    void clearTrace() { traceHead_.store(0, std::memory_order_relaxed); }
+
+#if CANBUS_FAULT_INJECTION
+    // Fault-Injection zwischen Library und Treiber, getrennt für Senden und Empfangen.
+    // Wahrscheinlichkeiten je Frame (0..1, Summe <= 1), gezogen aus einem Xorshift-PRNG mit
+    // festem Seed, damit Läufe reproduzierbar sind. corrupt kippt ein Nutzdatenbit (trifft
+    // die CRC8 fragmentierter Nachrichten), delay hält den Frame delayMs zurück, reorder
+    // tauscht ihn mit dem nächsten Frame derselben Richtung.
+    enum FaultDir : uint8_t { FAULT_TX = 0, FAULT_RX = 1 };
+
+    struct FaultProfile {
+        float drop = 0;
+        float corrupt = 0;
+        float duplicate = 0;
+        float delay = 0;
+        float reorder = 0;
+        uint32_t delayMs = 5;
+    };
+
+    struct FaultStats {
+        uint32_t frames;            // in die Stufe gelaufen
+        uint32_t dropped;
+        uint32_t corrupted;
+        uint32_t duplicated;
+        uint32_t delayed;
+        uint32_t reordered;
+    };
+
+    // Simulierter Fehlerzustand des Controllers
+    enum FaultBusState : uint8_t { FAULT_ERROR_ACTIVE = 0, FAULT_ERROR_PASSIVE, FAULT_BUS_OFF };
+
+    void setFaults(FaultDir dir, const FaultProfile& profile, uint32_t seed = 1) {
+        MutexLock lock(faultLock_);
+        FaultChannel& c = faults_[dir];
+        const float p[5] = {profile.drop, profile.corrupt, profile.duplicate, profile.delay, profile.reorder};
+        double sum = 0;
+        for (int i = 0; i < 5; ++i) {
+            sum += std::max(0.0f, p[i]);
+            c.threshold[i] = static_cast<uint32_t>(std::min(sum, 1.0) * 4294967295.0);
+        }
+        c.delayUs = profile.delayMs * 1000;
+        c.rng = seed ? seed : 1;
+        c.script.clear();
+        c.pos = 0;
+    }
+
+    // Skript statt Zufall: ein Zeichen je Frame, zyklisch wiederholt.
+    // '.' durchlassen, 'D' verwerfen, 'C' verfälschen, 'U' doppeln, 'L' verzögern, 'R' tauschen
+    void setFaultScript(FaultDir dir, const char* script, uint32_t delayMs = 5) {
+        MutexLock lock(faultLock_);
+        FaultChannel& c = faults_[dir];
+        c.script.assign(script, script + strlen(script));
+        c.pos = 0;
+        c.delayUs = delayMs * 1000;
+    }
+
+    // Error-Passive/Bus-Off simulieren: der passende Alert kommt beim nächsten handleReceive,
+    // im Bus-Off schlägt Senden mit ESP_ERR_INVALID_STATE fehl. Die Recovery läuft wie beim
+    // echten Treiber über setAutoRecovery() oder durch FAULT_ERROR_ACTIVE.
+    void injectBusState(FaultBusState state) {
+        MutexLock lock(faultLock_);
+        if (state == FAULT_ERROR_PASSIVE) faultAlerts_ |= TWAI_ALERT_ERR_PASS;
+        else if (state == FAULT_BUS_OFF) faultAlerts_ |= TWAI_ALERT_BUS_OFF;
+        else if (faultState_.load() != FAULT_ERROR_ACTIVE) faultAlerts_ |= TWAI_ALERT_ERR_ACTIVE;
+        faultState_.store(state);
+    }
+
+    FaultStats faultStats(FaultDir dir) const { return faults_[dir].stats; }
+
+    // Alle Fehlerbilder, Zähler und zurückgehaltenen Frames verwerfen
+    void clearFaults() {
+        MutexLock lock(faultLock_);
+        for (FaultChannel& c : faults_) c = FaultChannel();
+        delayed_.clear();
+        faultAlerts_ = 0;
+        faultState_.store(FAULT_ERROR_ACTIVE);
+    }
+#endif
+
+    // Sniffer-Mitschnitt (gedacht für TWAI_MODE_LISTEN_ONLY): ein RX-Task leert den Treiber
+    // mit voller Busrate in Blöcke (Format siehe can_capture.h), ein Writer-Task schreibt
+    // volle Blöcke nacheinander über sink, dazwischen Indexblöcke und am Ende den Trailer
+    // der Sitzung (ein weiterer Block Puffer). Mehrere Puffer (min. 2) überbrücken
+    // Schreiblatenzen. handleReceive() darf währenddessen nicht aufgerufen werden.
+    esp_err_t startCapture(CaptureSink sink, size_t buffers = 2,
+                           UBaseType_t prio = 10, BaseType_t core = 1) {
+        if (capturing()) return ESP_ERR_INVALID_STATE;          // auch Tasks vom letzten Lauf
+        if (!sink || buffers < 2) return ESP_ERR_INVALID_ARG;
+        capture_.mem.reset(new (std::nothrow) uint8_t[buffers * CANCapture::BLOCK_SIZE]);
+        capture_.state.reset(new (std::nothrow) std::atomic<uint8_t>[buffers]);
+        capture_.index.reset(new (std::nothrow) uint8_t[CANCapture::BLOCK_SIZE]());
+        if (!capture_.mem || !capture_.state || !capture_.index) return ESP_ERR_NO_MEM;
+        for (size_t i = 0; i < buffers; ++i) capture_.state[i].store(BUF_FREE);
+        capture_.sink = sink;
+        capture_.buffers = buffers;
+        capture_.fill = capture_.write = 0;
+        capture_.filling = false;
+        capture_.seq = 0;
+        capture_.sessionBlocks = 0;
+        capture_.frames.store(0);
+        capture_.blocks.store(0);
+        capture_.droppedFrames.store(0);
+        capture_.sinkErrors.store(0);
+        capture_.running.store(true);
+        TaskHandle_t task = nullptr;
+        if (xTaskCreatePinnedToCore(&CANBus::captureWriterTask, "can_cap_wr", 4096, this,
+                                    prio - 1, &task, core) != pdPASS) {
+            capture_.running.store(false);
+            return ESP_ERR_NO_MEM;
+        }
+        capture_.writer.store(task);
+        if (xTaskCreatePinnedToCore(&CANBus::captureRxTask, "can_cap_rx", 4096, this,
+                                    prio, &task, core) != pdPASS) {
+            capture_.running.store(false);          // Writer beendet sich selbst
+            return ESP_ERR_NO_MEM;
+        }
+        capture_.reader.store(task);
+        return ESP_OK;
+    }
+
+    // Mitschnitt beenden; der angefangene Block wird noch geschrieben
+    void stopCapture() { capture_.running.store(false); }
+
+    bool capturing() const {
+        return capture_.running.load() || capture_.reader.load() || capture_.writer.load();
+    }
+
+    // Momentaufnahme, auch während des Mitschnitts aus jedem Task
+    CaptureStats captureStats() const {
+        return CaptureStats{capture_.frames.load(std::memory_order_relaxed),
+                            capture_.blocks.load(std::memory_order_relaxed),
+                            capture_.droppedFrames.load(std::memory_order_relaxed),
+                            capture_.sinkErrors.load(std::memory_order_relaxed)};
+    }
+
+    // Senke für eine Flash-Partition: löscht sie einmal komplett (dauert einige Sekunden),
+    // damit beim Mitschnitt nur noch sequenziell geschrieben wird. Voll → ESP_ERR_INVALID_SIZE
+    static CaptureSink partitionSink(const esp_partition_t* part) {
+        if (!part || esp_partition_erase_range(part, 0, part->size) != ESP_OK) return nullptr;
+        std::shared_ptr<size_t> offset = std::make_shared<size_t>(0);
+        return [part, offset](const uint8_t* block, size_t len) -> esp_err_t {
+            if (*offset + len > part->size) return ESP_ERR_INVALID_SIZE;
+            esp_err_t e = esp_partition_write(part, *offset, block, len);
+            if (e == ESP_OK) *offset += len;
+            return e;
+        };
+    }
+
+    // Coalescing: kleine Nachrichten (<= 7 Byte) je Zieladresse in einen Frame bündeln.
+    // Muss auf Sender und Empfänger aktiv sein; Type-ID 6 ist dann reserviert.
+    // deadlineMs: max. Verweildauer im Puffer (wird in handleReceive geprüft).
+    // Direkt gesendete Nachrichten (8 Byte, fragmentiert, sendFromISR) schicken das Bündel
+    // ihrer Zieladresse vorher ab. Schlägt das Senden eines Bündels fehl, bleibt es erhalten
+    // und wird über onError (Type-ID 6) gemeldet.
+    // Mit TX-Worker wird die Änderung in den Worker eingereiht (ESP_ERR_NO_MEM = Queue voll)
+    esp_err_t setCoalescing(bool enable, uint32_t deadlineMs = 10) {
+        if (outsideWorker()) {
+            uint8_t data[sizeof(deadlineMs)];
+            memcpy(data, &deadlineMs, sizeof(deadlineMs));
+            return pushControl(&CANBus::coalescingQueued, enable, data, sizeof(data));
+        }
+        if (!enable) flush();
+        coalesce_ = enable;
+        coalesceDeadline_ = deadlineMs;
+        return ESP_OK;
+    }
+
+    // Alle gepufferten Bündel sofort senden (mit TX-Worker: dort eingereiht)
+    esp_err_t flush() {
+        if (outsideWorker()) return pushControl(&CANBus::flushQueued, 0, nullptr, 0);
+        esp_err_t result = ESP_OK;
+        for (uint8_t addr = 0; addr < 16; ++addr) {
+            esp_err_t e = flushBundle(addr);
+            if (e != ESP_OK) result = e;
+        }
+        return result;
+    }
+
+    // TX-Worker starten: send() ist danach aus beliebigen Tasks sicher. Nachrichten landen
+    // als Ganzes in einer lock-freien Queue; nur der Worker sendet, daher bleiben die
+    // Fragmente einer Nachricht zusammenhängend. Scheduler und Coalescing laufen im Worker:
+    // schedule()/scheduleInWindow() vorher aufrufen (danach nur noch aus dem Worker),
+    // flush(), setCoalescing() und unschedule() werden in die Queue eingereiht.
+    // Fragmentierte Nachrichten mit ACK: Empfang per startRxTask() oder handleReceive()
+    // in einem anderen Task, der Worker wartet blockierend auf das ACK.
+    // isrQueueLen: Slots für sendFromISR (je 8 Byte, vorab allokiert)
+    esp_err_t startTxWorker(size_t queueLen = 16, UBaseType_t prio = 5,
+                            BaseType_t core = tskNO_AFFINITY, uint32_t stackSize = 4096,
+                            size_t isrQueueLen = 8) {
+        if (txWorker_) return ESP_ERR_INVALID_STATE;
+        if (!txQueue_.init(queueLen) || !isrQueue_.init(isrQueueLen)) return ESP_ERR_NO_MEM;
+        if (xTaskCreatePinnedToCore(&CANBus::txWorkerTask, "can_tx", stackSize, this,
+                                    prio, &txWorker_, core) != pdPASS) {
+            txWorker_ = nullptr;
+            return ESP_ERR_NO_MEM;
+        }
+        return ESP_OK;
+    }
+
     // Nachricht senden (Struktur muss POD sein)
+    // Pfadwahl zur Compile-Zeit: <= 8 Byte → ein Frame, sonst Fragmente + CRC.
+    // Mit TX-Worker: nur Einreihen (ESP_ERR_NO_MEM = Queue voll), Fehler später via onError
     template<typename T>
     esp_err_t send(uint8_t prio, uint8_t addr, const T& msg) {
         static_assert(std::is_standard_layout<T>::value, "T must be POD");
-        constexpr uint8_t type = MsgTraits<T, 0>::TypeID;
-        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&msg);
-        size_t len = sizeof(T);
-        std::vector<uint8_t> buf(raw, raw + len);
-        bool fragmented = (len > 8);
-        if (fragmented) buf.push_back(crc8(raw, len));
-
-        uint8_t attempts = 0;
-        while (true) {
-            // Fragmente senden
-            size_t offset = 0;
-            while (offset < buf.size()) {
-                size_t chunk = std::min<size_t>(8, buf.size() - offset);
-                Sequence seq = !fragmented ? SINGLE :
-                    (offset == 0 ? START :
-                     (offset + chunk >= buf.size() ? END : MIDDLE));
-                twai_message_t m{};
-                m.identifier = buildId(prio, addr, seq, type);
-                m.extd = 0;
-                m.data_length_code = chunk;
-                memcpy(m.data, buf.data() + offset, chunk);
-                esp_err_t e = twai_transmit(&m, pdMS_TO_TICKS(100));
-                if (e != ESP_OK) return e;
-                offset += chunk;
-            }
-            // Bei nicht fragmentierten Nachrichten kein ACK
-            if (retryLimit_ == 0 || !fragmented) return ESP_OK;
-            // Auf ACK warten
-            if (waitAck(type, addr)) return ESP_OK;
-            // Retry-Limit erreicht?
-            if (++attempts > retryLimit_) break;
+        if (txWorker_ && xTaskGetCurrentTaskHandle() != txWorker_) {
+            if (sizeof(T) > CANBUS_TX_SLOT_SIZE) return ESP_ERR_INVALID_SIZE;
+            if (!txQueue_.push(&CANBus::sendQueued<T>, prio, addr,
+                               reinterpret_cast<const uint8_t*>(&msg), sizeof(T)))
+                return ESP_ERR_NO_MEM;
+            xTaskNotifyGive(txWorker_);
+            return ESP_OK;
         }
-        // Fehler-Callback
-        if (errorCb_) errorCb_(type, addr);
-        return ESP_FAIL;
+        return sendImpl(prio, addr, msg, std::integral_constant<bool, TxLayout<T>::single>());
     }
 
+    // Senden aus einer ISR (nur Einzelframe-Nachrichten, TX-Worker nötig): kopiert msg in
+    // einen lock-freien Ring, der Worker sendet sie vor allen anderen Nachrichten (nie
+    // gebündelt, auch bei aktivem Coalescing).
+    // higherPrioWoken für portYIELD_FROM_ISR(); ESP_ERR_NO_MEM = Ring voll.
+    // Bei ISRs mit ESP_INTR_FLAG_IRAM muss auch dieser Pfad im IRAM liegen.
+    template<typename T>
+    esp_err_t sendFromISR(uint8_t prio, uint8_t addr, const T& msg,
+                          BaseType_t* higherPrioWoken = nullptr) {
+        static_assert(std::is_standard_layout<T>::value, "T must be POD");
+        static_assert(TxLayout<T>::single, "sendFromISR: max. 8 Byte (ein Frame)");
+        if (!txWorker_) return ESP_ERR_INVALID_STATE;
+        if (!isrQueue_.push(&CANBus::sendQueued<T, false>, prio, addr,
+                            reinterpret_cast<const uint8_t*>(&msg), sizeof(T)))
+            return ESP_ERR_NO_MEM;
+        vTaskNotifyGiveFromISR(txWorker_, higherPrioWoken);
+        return ESP_OK;
+    }
+
+    // Empfangsdaten je Nachricht. Zeiten in lokaler Uhr (nowUs), gestempelt direkt nach
+    // twai_receive bzw. im RX-Task (startRxTask); toBusTime() rechnet in busTimeUs() um.
+    // Einzelframes: firstUs == lastUs
+    struct RxInfo {
+        int64_t firstUs;    // erster Frame (START)
+        int64_t lastUs;     // letzter Frame (END)
+        uint8_t prio;
+        uint8_t dest;       // Zieladresse (Bit 8..5: eigene Adresse oder 15 = Broadcast);
+                            // einen Absender enthält der Identifier nicht
+    };
+
     // Callback für empfangene Nachricht T
     template<typename T>
     void onReceive(std::function<void(const T&)> cb) {
-        constexpr uint8_t type = MsgTraits<T, 0>::TypeID;
-        handlers_[type] = [cb](const std::vector<uint8_t>& data) {
+        onReceive<T>(std::function<void(const T&, const RxInfo&)>(
+            [cb](const T& msg, const RxInfo&) { cb(msg); }));
+    }
+
+    // Wie oben, zusätzlich mit Empfangszeitpunkten, Priorität und Zieladresse (RxInfo)
+    template<typename T>
+    void onReceive(std::function<void(const T&, const RxInfo&)> cb) {
+        constexpr uint8_t type = MsgType<T>::TypeID;
+        rxSize_[type] = sizeof(T);
+        handlers_[type] = [cb](const std::vector<uint8_t>& data, const RxInfo& info) {
             if (data.size() < sizeof(T)) return;
             T msg;
             memcpy(&msg, data.data(), sizeof(T));
-            cb(msg);
+            cb(msg, info);
+        };
+    }
+
+    // Send-on-Change für T: changed(last, now) entscheidet, ob publish() sendet
+    // (z. B. ein Deadband<T>); nach maxSilenceMs wird in jedem Fall gesendet (0 = nie)
+    template<typename T>
+    void setPublishPolicy(std::function<bool(const T& last, const T& now)> changed,
+                          uint32_t maxSilenceMs) {
+        constexpr uint8_t type = MsgType<T>::TypeID;
+        MutexLock lock(publishLock_);
+        PublishPolicy& p = publishPolicies_[type];
+        p.size = sizeof(T);
+        p.maxSilence = maxSilenceMs;
+        p.changed = nullptr;
+        if (changed) p.changed = [changed](const uint8_t* last, const uint8_t* now) {
+            T a, b;
+            memcpy(&a, last, sizeof(T));
+            memcpy(&b, now, sizeof(T));
+            return changed(a, b);
         };
     }
 
+    // Wie send(), unterdrückt aber Nachrichten ohne relevante Änderung gegenüber dem
+    // zuletzt gesendeten Wert (ohne Policy: jede Byte-Änderung). ESP_OK auch wenn unterdrückt.
+    // ESP_ERR_INVALID_ARG, wenn die Policy der Type-ID für einen anderen Typ gesetzt wurde.
+    // Thread-sicher wie send(): Policies und letzte Werte liegen hinter publishLock_
+    // (send() läuft außerhalb; publizieren zwei Tasks gleichzeitig, kann doppelt gesendet werden)
+    template<typename T>
+    esp_err_t publish(uint8_t prio, uint8_t addr, const T& msg) {
+        static_assert(std::is_standard_layout<T>::value, "T must be POD");
+        constexpr uint8_t type = MsgType<T>::TypeID;
+        const uint8_t key = static_cast<uint8_t>(((addr & 0x0F) << 3) | type);
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&msg);
+        int64_t now = nowUs();
+        {
+            MutexLock lock(publishLock_);
+            auto pol = publishPolicies_.find(type);
+            bool hasPolicy = pol != publishPolicies_.end();
+            if (hasPolicy && pol->second.size != sizeof(T)) return ESP_ERR_INVALID_ARG;
+            auto rec = published_.find(key);
+            if (rec != published_.end() && rec->second.data.size() == sizeof(T)) {
+                bool changed = (hasPolicy && pol->second.changed)
+                    ? pol->second.changed(rec->second.data.data(), raw)
+                    : memcmp(rec->second.data.data(), raw, sizeof(T)) != 0;
+                uint32_t maxSilence = hasPolicy ? pol->second.maxSilence : 0;
+                bool stale = maxSilence != 0 && now - rec->second.sent >= static_cast<int64_t>(maxSilence) * 1000;
+                if (!changed && !stale) return ESP_OK;
+            }
+        }
+        esp_err_t e = send<T>(prio, addr, msg);
+        if (e == ESP_OK) {
+            MutexLock lock(publishLock_);
+            PublishRecord& rec = published_[key];
+            rec.data.assign(raw, raw + sizeof(T));
+            rec.sent = now;
+        }
+        return e;
+    }
+
+    // Periodische Nachricht registrieren. msg wird per Referenz gehalten (muss gültig bleiben)
+    // und in jedem Zyklus gesendet. AUTO_PHASE legt den Offset in die größte Lücke
+    // der vorhandenen Einträge, damit Nachrichten nicht gebündelt auf den Bus gehen.
+    // Rückgabe: Handle für unschedule(), INVALID_HANDLE nach startTxWorker() (außer im Worker)
+    template<typename T>
+    size_t schedule(uint8_t prio, uint8_t addr, const T& msg,
+                    uint32_t periodMs, uint32_t phaseMs = AUTO_PHASE) {
+        static_assert(std::is_standard_layout<T>::value, "T must be POD");
+        if (outsideWorker()) return INVALID_HANDLE;
+        if (periodMs == 0) periodMs = 1;
+        if (phaseMs == AUTO_PHASE) phaseMs = autoPhase(periodMs);
+        int64_t now = nowUs();
+        if (schedule_.empty()) scheduleEpoch_ = now;
+        CyclicEntry e;
+        e.tx = [this, prio, addr, &msg]() { return send<T>(prio, addr, msg); };
+        e.period = periodMs;
+        e.phase = phaseMs % periodMs;
+        e.next = scheduleEpoch_ + static_cast<int64_t>(e.phase) * 1000;
+        const int64_t period = static_cast<int64_t>(periodMs) * 1000;
+        if (e.next < now) e.next += period * ((now - e.next + period - 1) / period);
+        schedule_.push_back(e);
+        return schedule_.size() - 1;
+    }
+
+    // Periodische Nachricht abmelden (mit TX-Worker: dort eingereiht)
+    esp_err_t unschedule(size_t handle) {
+        if (outsideWorker()) {
+            uint8_t data[sizeof(handle)];
+            memcpy(data, &handle, sizeof(handle));
+            return pushControl(&CANBus::unscheduleQueued, 0, data, sizeof(data));
+        }
+        if (handle < schedule_.size()) schedule_[handle].tx = nullptr;
+        return ESP_OK;
+    }
+
+    // Mailbox für T statt Callback: Empfang überschreibt nur den letzten Wert.
+    // notify: optionaler Task, der per xTaskNotifyGive geweckt wird
+    template<typename T>
+    void attachMailbox(Mailbox<T>& mb, TaskHandle_t notify = nullptr) {
+        static_assert(std::is_standard_layout<T>::value, "T must be POD");
+        constexpr uint8_t type = MsgType<T>::TypeID;
+        Mailbox<T>* box = &mb;
+        rxSize_[type] = sizeof(T);
+        handlers_[type] = [box, notify](const std::vector<uint8_t>& data, const RxInfo& info) {
+            if (data.size() < sizeof(T)) return;
+            box->write(data.data(), info.lastUs);
+            if (notify) xTaskNotifyGive(notify);
+        };
+    }
+
+    // Entkoppelte Zustellung: handleReceive() reiht fertige Nachrichten in SPSC-Ringe
+    // ein (einer je Priorität, depth Slots), Callbacks laufen erst in processReceived() im
+    // Anwendungs-Task (z. B. anderer Kern). Nachrichten > CANBUS_RX_SLOT_SIZE werden
+    // verworfen. notify: optional zu weckender Task
+    // BLOCK wartet nur im RX-Task (startRxTask()) und höchstens CANBUS_RX_BLOCK_MS; ruft
+    // derselbe Task handleReceive() und processReceived() auf, könnte er sich selbst nie
+    // freigeben – dort (und bei injectFrame) gilt DROP_NEWEST.
+    esp_err_t setDeferredDelivery(size_t depth, Backpressure policy = DROP_OLDEST,
+                                  TaskHandle_t notify = nullptr) {
+        for (RxRing& ring : rxRings_)
+            if (!ring.init(depth)) return ESP_ERR_NO_MEM;
+        rxPolicy_ = policy;
+        rxNotify_ = notify;
+        deferred_ = true;
+        return ESP_OK;
+    }
+
+    // Im Anwendungs-Task aufrufen: bis zu max Nachrichten zustellen. Bei Rückstau kommt
+    // immer zuerst die höchste Priorität (3) an die Reihe, wie bei der Arbitrierung.
+    size_t processReceived(size_t max = SIZE_MAX) {
+        size_t n = 0;
+        RxSlot slot;
+        while (n < max) {
+            int prio = 3;
+            while (prio >= 0 && !rxRings_[prio].pop(slot)) --prio;
+            if (prio < 0) break;
+            deliver(slot.type, std::vector<uint8_t>(slot.data, slot.data + slot.len), slot.info);
+            ++n;
+        }
+        return n;
+    }
+
+    // Anzahl wegen voller/zu kleiner Queue verworfener Nachrichten
+    uint32_t droppedReceived() const {
+        uint32_t n = 0;
+        for (const RxRing& ring : rxRings_) n += ring.dropped();
+        return n;
+    }
+
     // Im Loop oder Task aufrufen
+    // Bedient auch Coalescing-Deadlines und periodische Nachrichten; die Wartezeit
+    // auf Frames endet spätestens beim nächsten fälligen Zyklus.
     void handleReceive() {
+        if (!rxTask_) rxOwner_.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+        serviceBus();
+        uint32_t waitMs = txWorker_ ? 10 : serviceTx();
+        if (syncRole_ == SYNC_MASTER) {
+            int64_t left = (syncDue_ - nowUs()) / 1000;
+            waitMs = static_cast<uint32_t>(std::max<int64_t>(0, std::min<int64_t>(waitMs, left)));
+        }
+        if (rxTask_) {
+            vTaskDelay(pdMS_TO_TICKS(waitMs));
+            return;
+        }
         twai_message_t m;
-        if (twai_receive(&m, pdMS_TO_TICKS(10)) != ESP_OK) return;
+        if (twai_receive(&m, pdMS_TO_TICKS(waitMs)) != ESP_OK) return;
+        receiveFrame(m, nowUs());
+    }
+
+    // Eigener RX-Task: blockiert in twai_receive und stempelt jeden Frame direkt nach dem
+    // Aufwachen – ohne Hardware-Zeitstempel die früheste Stelle, unabhängig vom Takt von
+    // handleReceive(). Reassembly und Callbacks laufen dann in diesem Task (mit
+    // setDeferredDelivery() in den Anwendungs-Task verlagern); handleReceive() bedient
+    // weiterhin Alerts, Zeitsync und zyklisches Senden. Nicht zusammen mit startCapture().
+    esp_err_t startRxTask(UBaseType_t prio = 10,
+                          BaseType_t core = tskNO_AFFINITY, uint32_t stackSize = 4096) {
+        if (rxTask_.load() || capturing()) return ESP_ERR_INVALID_STATE;
+        rxStop_.store(false);
+        TaskHandle_t task = nullptr;
+        if (xTaskCreatePinnedToCore(&CANBus::rxTaskMain, "can_rx", stackSize, this,
+                                    prio, &task, core) != pdPASS)
+            return ESP_ERR_NO_MEM;
+        rxTask_.store(task);
+        return ESP_OK;
+    }
+
+    // RX-Task beenden (spätestens nach 100 ms); danach empfängt wieder handleReceive()
+    void stopRxTask() { rxStop_.store(true); }
+
+    bool rxTaskRunning() const { return rxTask_.load() != nullptr; }
+
+    // Lokale Empfangszeit (RxInfo, nowUs) in die gemeinsame Zeitbasis von busTimeUs()
+    int64_t toBusTime(int64_t localUs) const {
+        if (syncRole_ != SYNC_SLAVE) return localUs;
+        SyncPoint p;
+        if (!readSyncPoint(p)) return localUs;
+        return toMasterTime(p, localUs);
+    }
+
+    // Frame von außen in den Empfangspfad geben (Replay eines Mitschnitts, Host-Simulation).
+    // timeUs ist die Zeit des Frames, nicht die aktuelle: Reassembly-Timeouts laufen damit
+    // in Mitschnittzeit und das Ergebnis hängt nicht von der Abspielgeschwindigkeit ab.
+    // Es werden keine ACKs gesendet (die Originale sind im Mitschnitt enthalten).
+    void injectFrame(uint32_t identifier, const uint8_t* data, uint8_t dlc, int64_t timeUs) {
+        twai_message_t m{};
+        m.identifier = identifier & 0x7FF;
+        m.data_length_code = dlc > 8 ? 8 : dlc;
+        memcpy(m.data, data, m.data_length_code);
+        processFrame(m, timeUs, false);
+    }
+
+private:
+    static void rxTaskMain(void* arg) {
+        CANBus* bus = static_cast<CANBus*>(arg);
+        twai_message_t m{};
+        while (!bus->rxStop_.load()) {
+            uint32_t waitMs = 100;
+#if CANBUS_FAULT_INJECTION
+            // Von der Fault-Stufe zurückgehaltene RX-Frames in diesem Task zustellen, nicht
+            // im Task von handleReceive() (Reassembly und Handler gehören dem RX-Task)
+            waitMs = std::min(waitMs, bus->serviceFaults(1u << FAULT_RX));
+#endif
+            esp_err_t e = twai_receive(&m, pdMS_TO_TICKS(waitMs));
+            if (e == ESP_OK) bus->receiveFrame(m, bus->nowUs());
+            else if (e != ESP_ERR_TIMEOUT) vTaskDelay(1);      // Treiber gestoppt
+        }
+        bus->rxTask_.store(nullptr);
+        vTaskDelete(nullptr);
+    }
+
+    // Frame vom Treiber; timeUs = Zeitpunkt direkt nach twai_receive
+    void receiveFrame(const twai_message_t& m, int64_t timeUs) {
+#if CANBUS_FAULT_INJECTION
+        twai_message_t out[3];
+        for (uint8_t i = 0, n = applyFault(FAULT_RX, m, timeUs, out); i < n; ++i)
+            processFrame(out[i], timeUs, true);
+#else
+        processFrame(m, timeUs, true);
+#endif
+    }
+
+    void processFrame(const twai_message_t& m, int64_t timeUs, bool ack) {
+        CANBUS_PROFILE(PROF_RX);
+        trace(m, TRACE_RX, timeUs);
         uint32_t id = m.identifier;
         uint8_t seq = (id >> 3) & 0x03;
         uint8_t type = id & 0x07;
-        uint8_t from = (id >> 5) & 0x0F;
+        uint8_t dest = (id >> 5) & 0x0F;
+        uint8_t prio = 3 - ((id >> 9) & 0x03);
         // ACK-Frame
         if (type == ACK_TYPE_ID) {
-            pendingAck_ = m.data_length_code>0 ? m.data[0] : 0;
+            if (m.data_length_code > 0 && m.data[0] >= SYNC_CODE) handleSyncFrame(m, timeUs);
+            else {
+                if (m.data_length_code > 0) pendingAck_ = ACK_PENDING | (m.data[0] & 0x07);
+                if (ackSem_) xSemaphoreGive(ackSem_);      // ohne init() (Replay) kein Sender
+            }
             return;
         }
-        uint32_t baseId = id & ~static_cast<uint32_t>(0x18);
-        auto now = std::chrono::steady_clock::now();
-        FragEntry& entry = fragMap_[baseId];
-        if (seq == START) {
-            entry.data.clear();
-            entry.timestamp = now;
-            append(entry, m);
-        } else if (seq == MIDDLE) {
-            if (expired(entry.timestamp, now)) { fragMap_.erase(baseId); return; }
-            append(entry, m);
-        } else if (seq == END) {
-            if (expired(entry.timestamp, now)) { fragMap_.erase(baseId); return; }
-            append(entry, m);
-            if (entry.data.size() < 1) { fragMap_.erase(baseId); return; }
-            uint8_t recvCrc = entry.data.back();
-            entry.data.pop_back();
-            if (recvCrc == crc8(entry.data.data(), entry.data.size())) {
-                dispatch(type, entry.data);
-                sendAck(from, type);
-            }
-            fragMap_.erase(baseId);
+        if (seq != SINGLE) {
+            CANReassembler::Message msg;
+            CANReassembler::Result r;
+            {
+                CANBUS_PROFILE(PROF_REASSEMBLY);
+                r = reassembler_.push(id, m.data, m.data_length_code, timeUs, msg);
+            }
+            if (r == CANReassembler::COMPLETE) {
+                dispatch(prio, type | STAMPED, msg.data, RxInfo{msg.firstUs, msg.lastUs, prio, dest});
+                if (ack) sendAck(dest, type);
+            } else if (r == CANReassembler::LIMIT) {
+                ++stats_.reassemblyLimit;
+            }
+        } else if (type == BUNDLE_TYPE_ID && coalesce_) {
+            unbundle(m, RxInfo{timeUs, timeUs, prio, dest});
         } else { // SINGLE
             std::vector<uint8_t> d(m.data, m.data + m.data_length_code);
-            dispatch(type, d);
+            dispatch(prio, type | STAMPED, d, RxInfo{timeUs, timeUs, prio, dest});
         }
     }
 
-private:
-    struct FragEntry {
+    // Begrenzte lock-freie MPSC-Queue ganzer Nachrichten (nach Vyukov). Beliebig viele
+    // Produzenten, genau ein Konsument (TX-Worker). N = max. Nutzdaten je Slot.
+    template<size_t N>
+    class MsgRing {
+    public:
+        using SendFn = esp_err_t (*)(CANBus* bus, uint8_t prio, uint8_t addr, const uint8_t* data);
+        struct Slot {
+            std::atomic<uint32_t> seq;
+            SendFn fn;
+            uint8_t prio;
+            uint8_t addr;
+            uint8_t data[N];
+        };
+
+        // Kapazität wird auf die nächste Zweierpotenz aufgerundet
+        bool init(size_t capacity) {
+            size_t n = 1;
+            while (n < capacity) n <<= 1;
+            slots_.reset(new (std::nothrow) Slot[n]);
+            if (!slots_) return false;
+            for (size_t i = 0; i < n; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+            mask_ = n - 1;
+            head_.store(0, std::memory_order_relaxed);
+            tail_ = 0;
+            return true;
+        }
+
+        // false, wenn die Queue voll ist
+        bool push(SendFn fn, uint8_t prio, uint8_t addr, const uint8_t* data, size_t len) {
+            uint32_t pos = head_.load(std::memory_order_relaxed);
+            Slot* slot;
+            while (true) {
+                slot = &slots_[pos & mask_];
+                int32_t dif = static_cast<int32_t>(slot->seq.load(std::memory_order_acquire) - pos);
+                if (dif == 0) {
+                    if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;
+                } else {
+                    pos = head_.load(std::memory_order_relaxed);
+                }
+            }
+            slot->fn = fn;
+            slot->prio = prio;
+            slot->addr = addr;
+            if (len) memcpy(slot->data, data, len);
+            slot->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Nur Konsument: ältesten belegten Slot liefern (nullptr = leer), danach pop()
+        Slot* front() {
+            if (!slots_) return nullptr;
+            Slot* slot = &slots_[tail_ & mask_];
+            if (slot->seq.load(std::memory_order_acquire) != tail_ + 1) return nullptr;
+            return slot;
+        }
+
+        void pop() {
+            slots_[tail_ & mask_].seq.store(tail_ + mask_ + 1, std::memory_order_release);
+            ++tail_;
+        }
+
+    private:
+        std::unique_ptr<Slot[]> slots_;
+        uint32_t mask_ = 0;
+        std::atomic<uint32_t> head_{0};
+        uint32_t tail_ = 0;
+    };
+
+    // Übergabe-Slot RX → Anwendung
+    struct RxSlot {
+        RxInfo info;
+        uint8_t type;
+        uint16_t len;
+        uint8_t data[CANBUS_RX_SLOT_SIZE];
+    };
+
+    // SPSC-Ring mit getrennten Cache-Lines für Kopf und Ende. DROP_OLDEST verschiebt das
+    // Ende per CAS; der Konsument verwirft dann seine Kopie und liest erneut.
+    class RxRing {
+    public:
+        bool init(size_t capacity) {
+            size_t n = 1;
+            while (n < capacity) n <<= 1;
+            slots_.reset(new (std::nothrow) RxSlot[n]);
+            if (!slots_) return false;
+            mask_ = n - 1;
+            head_.store(0, std::memory_order_relaxed);
+            tail_.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Nur Produzent (RX-Pfad)
+        bool push(uint8_t type, const uint8_t* data, size_t len, const RxInfo& info,
+                  Backpressure policy, TickType_t blockTicks = 0) {
+            if (len > CANBUS_RX_SLOT_SIZE) { dropped_.fetch_add(1, std::memory_order_relaxed); return false; }
+            uint32_t h = head_.load(std::memory_order_relaxed);
+            while (h - tail_.load(std::memory_order_acquire) > mask_) {
+                if (policy == DROP_NEWEST) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                } else if (policy == DROP_OLDEST) {
+                    uint32_t t = tail_.load(std::memory_order_acquire);
+                    if (h - t > mask_ && tail_.compare_exchange_strong(t, t + 1))
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                } else if (!blockTicks--) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                } else {
+                    vTaskDelay(1);
+                }
+            }
+            RxSlot& slot = slots_[h & mask_];
+            slot.info = info;
+            slot.type = type;
+            slot.len = static_cast<uint16_t>(len);
+            memcpy(slot.data, data, len);
+            head_.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Nur Konsument (Anwendung)
+        bool pop(RxSlot& out) {
+            if (!slots_) return false;
+            while (true) {
+                uint32_t t = tail_.load(std::memory_order_acquire);
+                if (t == head_.load(std::memory_order_acquire)) return false;
+                const RxSlot& slot = slots_[t & mask_];
+                out.info = slot.info;
+                out.type = slot.type;
+                out.len = std::min<uint16_t>(slot.len, CANBUS_RX_SLOT_SIZE);
+                memcpy(out.data, slot.data, out.len);
+                if (tail_.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) return true;
+            }
+        }
+
+        uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<RxSlot[]> slots_;
+        uint32_t mask_ = 0;
+        std::atomic<uint32_t> dropped_{0};
+        alignas(CANBUS_CACHE_LINE) std::atomic<uint32_t> head_{0};
+        alignas(CANBUS_CACHE_LINE) std::atomic<uint32_t> tail_{0};
+    };
+
+    // Send-on-Change: Kriterium je Typ, letzter gesendeter Wert je Adresse + Typ
+    struct PublishPolicy {
+        std::function<bool(const uint8_t* last, const uint8_t* now)> changed;
+        uint32_t maxSilence = 0;
+        size_t size = 0;            // sizeof(T) bei setPublishPolicy
+    };
+    struct PublishRecord {
         std::vector<uint8_t> data;
-        std::chrono::steady_clock::time_point timestamp;
+        int64_t sent = 0;           // µs
+    };
+
+    // Mutex mit Prioritätsvererbung statt Spinlock (ein höher priorisierter Task auf
+    // demselben Core würde den Halter nie weiterlaufen lassen)
+    struct MutexLock {
+        explicit MutexLock(SemaphoreHandle_t m) : m_(m) { xSemaphoreTake(m_, portMAX_DELAY); }
+        ~MutexLock() { xSemaphoreGive(m_); }
+        SemaphoreHandle_t m_;
+    };
+    // Eintrag des zyklischen Schedulers
+    struct CyclicEntry {
+        std::function<esp_err_t()> tx;
+        uint32_t period;
+        uint32_t phase;
+        int64_t next;               // nächster Termin (µs)
     };
+    // Sammelpuffer für Coalescing, einer je Zieladresse
+    struct Bundle {
+        uint8_t len = 0;
+        uint8_t prio = 0;
+        uint8_t data[8];
+        int64_t since = 0;          // erste Nachricht im Puffer (µs)
+    };
+
+    // Baudrate → Bit-Timing des Treibers (APB-Takt wie in den IDF-Makros)
+    static bool timingFor(uint32_t baud, twai_timing_config_t& t) {
+        switch (baud) {
+        case 25000:   t = TWAI_TIMING_CONFIG_25KBITS(); return true;
+        case 50000:   t = TWAI_TIMING_CONFIG_50KBITS(); return true;
+        case 100000:  t = TWAI_TIMING_CONFIG_100KBITS(); return true;
+        case 125000:  t = TWAI_TIMING_CONFIG_125KBITS(); return true;
+        case 250000:  t = TWAI_TIMING_CONFIG_250KBITS(); return true;
+        case 500000:  t = TWAI_TIMING_CONFIG_500KBITS(); return true;
+        case 800000:  t = TWAI_TIMING_CONFIG_800KBITS(); return true;
+        case 1000000: t = TWAI_TIMING_CONFIG_1MBITS(); return true;
+        default:      return false;
+        }
+    }
+
     twai_general_config_t config_{};
     twai_timing_config_t timing_{};
+    uint32_t bitrate_ = 0;                          // 0 = nicht unterstützte Baudrate
     twai_filter_config_t filter_{};
     uint8_t retryLimit_;
     ErrorCallback errorCb_;
-    uint8_t pendingAck_ = 0;
-    std::unordered_map<uint32_t, FragEntry> fragMap_;
-    std::unordered_map<uint8_t, std::function<void(const std::vector<uint8_t>&)>> handlers_;
+    ClockFn clock_ = &esp_timer_get_time;
+    uint8_t nodeAddress_ = 0;
+    static constexpr uint8_t ACK_PENDING = 0x80;    // pendingAck_ = ACK_PENDING | Type-ID, 0 = keins
+    std::atomic<uint8_t> pendingAck_{0};
+    CANReassembler reassembler_{REASSEMBLY_TIMEOUT * 1000};
+    std::unordered_map<uint8_t, std::function<void(const std::vector<uint8_t>&, const RxInfo&)>> handlers_;
+    size_t rxSize_[8] = {};                         // sizeof(T) je Type-ID mit Handler
+    std::atomic<bool> coalesce_{false};
+    uint32_t coalesceDeadline_ = 10;
+    Bundle bundles_[16];
+    std::vector<CyclicEntry> schedule_;
+    std::unordered_map<uint8_t, PublishPolicy> publishPolicies_;
+    std::unordered_map<uint8_t, PublishRecord> published_;
+    SemaphoreHandle_t publishLock_ = nullptr;       // publishPolicies_ und published_
+    MsgRing<CANBUS_TX_SLOT_SIZE> txQueue_;
+    MsgRing<8> isrQueue_;
+    RxRing rxRings_[4];   // Index = Priorität
+    Backpressure rxPolicy_ = DROP_OLDEST;
+    TaskHandle_t rxNotify_ = nullptr;
+    bool deferred_ = false;
+    BusStats stats_{};
+#if CANBUS_TRACE_SIZE > 0
+    static_assert((CANBUS_TRACE_SIZE & (CANBUS_TRACE_SIZE - 1)) == 0,
+                  "CANBUS_TRACE_SIZE muss eine Zweierpotenz sein");
+    TraceEntry trace_[CANBUS_TRACE_SIZE];
+#endif
+    std::atomic<uint32_t> traceHead_{0};
 
-    void append(FragEntry& entry, const twai_message_t& msg) {
-        entry.data.insert(entry.data.end(), msg.data, msg.data + msg.data_length_code);
+    // Capture: Pufferzustände und Tasks
+    enum CaptureBuf : uint8_t { BUF_FREE=0, BUF_FILLING=1, BUF_FULL=2 };
+    struct Capture {
+        CaptureSink sink;
+        std::unique_ptr<uint8_t[]> mem;
+        std::unique_ptr<std::atomic<uint8_t>[]> state;
+        size_t buffers = 0;
+        size_t fill = 0;            // Puffer, den der RX-Task füllt
+        size_t write = 0;           // nächster Puffer für den Writer (Reihenfolge bleibt)
+        bool filling = false;
+        uint32_t seq = 0;
+        std::atomic<bool> running{false};
+        std::atomic<TaskHandle_t> reader{nullptr};
+        std::atomic<TaskHandle_t> writer{nullptr};
+        std::unique_ptr<uint8_t[]> index;   // Indexblock im Aufbau (nur Writer)
+        uint32_t sessionBlocks = 0;         // geschriebene Blöcke der Sitzung
+        // CaptureStats, geschrieben von RX- bzw. Writer-Task
+        std::atomic<uint32_t> frames{0};
+        std::atomic<uint32_t> blocks{0};
+        std::atomic<uint32_t> droppedFrames{0};
+        std::atomic<uint32_t> sinkErrors{0};
+    };
+    Capture capture_;
+    AlertCallback alertCb_;
+    bool autoRecovery_ = false;
+    bool recoveryPending_ = false;
+    uint32_t backoffInitial_ = 10;
+    uint32_t backoffMax_ = 1000;
+    uint32_t backoff_ = 10;
+    int64_t busOffAt_ = 0;
+    int64_t recoveryDue_ = 0;
+    TaskHandle_t txWorker_ = nullptr;
+    std::atomic<TaskHandle_t> rxTask_{nullptr};
+    std::atomic<bool> rxStop_{false};
+    std::atomic<TaskHandle_t> rxOwner_{nullptr};    // Task in handleReceive() (ohne RX-Task)
+    SemaphoreHandle_t ackSem_ = nullptr;            // vom Empfangspfad bei jedem ACK gegeben
+    std::atomic<uint32_t> queuedTxFailed_{0};       // Fehler eingereihter Nachrichten (Worker)
+
+    // Vom TX-Worker aufgerufen: Nachricht aus der Queue über den typisierten Pfad senden
+    // (Bundle = false: aus sendFromISR, nie gebündelt)
+    template<typename T, bool Bundle = true>
+    static esp_err_t sendQueued(CANBus* bus, uint8_t prio, uint8_t addr, const uint8_t* data) {
+        T msg;
+        memcpy(&msg, data, sizeof(T));
+        esp_err_t e = bus->sendImpl(prio, addr, msg, std::integral_constant<bool, TxLayout<T>::single>(), Bundle);
+        if (e != ESP_OK) {
+            bus->queuedTxFailed_.fetch_add(1, std::memory_order_relaxed);
+            // ESP_FAIL (ACK-Retries erschöpft) hat sendImpl schon gemeldet
+            if (e != ESP_FAIL && bus->errorCb_) bus->errorCb_(MsgType<T>::TypeID, addr);
+        }
+        return e;
     }
 
-    bool waitAck(uint8_t type, uint8_t addr) {
-        auto start = std::chrono::steady_clock::now();
-        while (std::chrono::duration_cast<std::chrono::milliseconds>(
-                   std::chrono::steady_clock::now() - start).count() < 100) {
-            if (pendingAck_ == type) {
-                pendingAck_ = 0;
-                return true;
+    // Nach startTxWorker(): Zustand des Workers nur noch über dessen Queue ändern
+    bool outsideWorker() const { return txWorker_ && xTaskGetCurrentTaskHandle() != txWorker_; }
+
+    esp_err_t pushControl(MsgRing<CANBUS_TX_SLOT_SIZE>::SendFn fn, uint8_t arg, const uint8_t* data, size_t len) {
+        if (!txQueue_.push(fn, arg, 0, data, len)) return ESP_ERR_NO_MEM;
+        xTaskNotifyGive(txWorker_);
+        return ESP_OK;
+    }
+
+    static esp_err_t flushQueued(CANBus* bus, uint8_t, uint8_t, const uint8_t*) { return bus->flush(); }
+
+    static esp_err_t coalescingQueued(CANBus* bus, uint8_t enable, uint8_t, const uint8_t* data) {
+        uint32_t deadlineMs;
+        memcpy(&deadlineMs, data, sizeof(deadlineMs));
+        return bus->setCoalescing(enable != 0, deadlineMs);
+    }
+
+    static esp_err_t unscheduleQueued(CANBus* bus, uint8_t, uint8_t, const uint8_t* data) {
+        size_t handle;
+        memcpy(&handle, data, sizeof(handle));
+        return bus->unschedule(handle);
+    }
+
+    static void txWorkerTask(void* arg) {
+        CANBus* bus = static_cast<CANBus*>(arg);
+        while (true) {
+            uint32_t waitMs = bus->serviceTx();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+            // ISR-Nachrichten haben Vorrang: vor jeder Task-Nachricht erneut prüfen.
+            // Sendefehler meldet sendQueued (onError, busStats().queuedTxFailed).
+            bool busy = true;
+            while (busy) {
+                busy = false;
+                while (auto* slot = bus->isrQueue_.front()) {
+                    slot->fn(bus, slot->prio, slot->addr, slot->data);
+                    bus->isrQueue_.pop();
+                }
+                if (auto* slot = bus->txQueue_.front()) {
+                    slot->fn(bus, slot->prio, slot->addr, slot->data);
+                    bus->txQueue_.pop();
+                    busy = true;
+                }
+            }
+        }
+    }
+
+    static void captureRxTask(void* arg) {
+        CANBus* bus = static_cast<CANBus*>(arg);
+        Capture& c = bus->capture_;
+        twai_message_t m{};
+        while (c.running.load(std::memory_order_relaxed)) {
+            if (twai_receive(&m, pdMS_TO_TICKS(100)) != ESP_OK) continue;
+            bus->captureFrame(m, bus->nowUs());
+        }
+        if (c.filling) bus->captureBlockDone();
+        xTaskNotifyGive(c.writer.load());
+        c.reader.store(nullptr);      // erst danach darf der Writer sich beenden
+        vTaskDelete(nullptr);
+    }
+
+    static void captureWriterTask(void* arg) {
+        CANBus* bus = static_cast<CANBus*>(arg);
+        Capture& c = bus->capture_;
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            // Vor dem Leeren prüfen: ist der RX-Task fertig, sind alle Blöcke schon voll
+            const bool last = !c.reader.load() && !c.running.load();
+            while (c.state[c.write].load(std::memory_order_acquire) == BUF_FULL) {
+                const uint8_t* block = c.mem.get() + c.write * CANCapture::BLOCK_SIZE;
+                if (c.sink(block, CANCapture::BLOCK_SIZE) == ESP_OK) {
+                    c.blocks.fetch_add(1, std::memory_order_relaxed);
+                    bus->captureIndexBlock(block);
+                } else {
+                    c.sinkErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                c.state[c.write].store(BUF_FREE, std::memory_order_release);
+                c.write = (c.write + 1) % c.buffers;
+            }
+            if (last) break;
+        }
+        bus->captureWriteIndex(true);
+        c.writer.store(nullptr);
+        vTaskDelete(nullptr);
+    }
+
+    void captureFrame(const twai_message_t& m, int64_t nowUs) {
+        Capture& c = capture_;
+        uint8_t* block = c.mem.get() + c.fill * CANCapture::BLOCK_SIZE;
+        CANCapture::BlockHeader* h = reinterpret_cast<CANCapture::BlockHeader*>(block);
+        if (!c.filling) {
+            if (c.state[c.fill].load(std::memory_order_acquire) != BUF_FREE) {
+                c.droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            c.state[c.fill].store(BUF_FILLING, std::memory_order_relaxed);
+            memset(block, 0, CANCapture::BLOCK_SIZE);
+            h->magic = CANCapture::BLOCK_MAGIC;
+            h->version = CANCapture::VERSION;
+            h->seq = c.seq++;
+            h->baseUs = nowUs;
+            c.filling = true;
+        }
+        CANCapture::Record* r = reinterpret_cast<CANCapture::Record*>(block + sizeof(*h)) + h->count;
+        r->deltaUs = static_cast<uint32_t>(nowUs - h->baseUs);
+        r->identifier = static_cast<uint16_t>(m.identifier & 0x7FF);
+        r->dlc = m.data_length_code;
+        memcpy(r->data, m.data, 8);
+        h->lastUs = nowUs;
+        CANCapture::markId(*h, r->identifier);
+        c.frames.fetch_add(1, std::memory_order_relaxed);
+        if (++h->count == CANCapture::RECORDS_PER_BLOCK) captureBlockDone();
+    }
+
+    // Geschriebenen Datenblock in den Sitzungsindex aufnehmen (Writer-Task)
+    void captureIndexBlock(const uint8_t* block) {
+        Capture& c = capture_;
+        CANCapture::IndexHeader* ih = reinterpret_cast<CANCapture::IndexHeader*>(c.index.get());
+        const CANCapture::BlockHeader* h = reinterpret_cast<const CANCapture::BlockHeader*>(block);
+        CANCapture::IndexEntry* e =
+            reinterpret_cast<CANCapture::IndexEntry*>(c.index.get() + sizeof(*ih)) + ih->count;
+        e->seq = h->seq;
+        e->count = h->count;
+        e->baseUs = h->baseUs;
+        e->lastUs = h->lastUs;
+        ++c.sessionBlocks;
+        if (++ih->count == CANCapture::INDEX_ENTRIES) captureWriteIndex(false);
+    }
+
+    // Indexblock schreiben; der Trailer schließt die Sitzung ab (auch ohne Einträge)
+    void captureWriteIndex(bool trailer) {
+        Capture& c = capture_;
+        CANCapture::IndexHeader* ih = reinterpret_cast<CANCapture::IndexHeader*>(c.index.get());
+        ih->magic = CANCapture::INDEX_MAGIC;
+        ih->version = CANCapture::VERSION;
+        ih->flags = trailer ? CANCapture::INDEX_TRAILER : 0;
+        ih->sessionBlocks = trailer ? c.sessionBlocks + 1 : 0;
+        if (c.sink(c.index.get(), CANCapture::BLOCK_SIZE) == ESP_OK) ++c.sessionBlocks;
+        else c.sinkErrors.fetch_add(1, std::memory_order_relaxed);
+        memset(c.index.get(), 0, CANCapture::BLOCK_SIZE);
+    }
+
+    void captureBlockDone() {
+        Capture& c = capture_;
+        c.state[c.fill].store(BUF_FULL, std::memory_order_release);
+        c.fill = (c.fill + 1) % c.buffers;
+        c.filling = false;
+        xTaskNotifyGive(c.writer.load());
+    }
+
+#if CANBUS_PROFILING
+    // Misst die Laufzeit des umgebenden Blocks in Zyklen
+    struct ProfileScope {
+        explicit ProfileScope(Histogram& h) : h_(h), start_(cycles()) {}
+        ~ProfileScope() { h_.record(cycles() - start_); }
+        Histogram& h_;
+        uint32_t start_;
+    };
+    Histogram profile_[PROF_STAGES];
+#endif
+
+    // Einziger Sendepfad zum Treiber; zeichnet erfolgreich eingereihte Frames auf
+    esp_err_t transmit(const twai_message_t& m, TickType_t timeout) {
+        TaskHandle_t owner = ttOwner_.load();
+        if (ttCycleUs_ && (!owner || owner != xTaskGetCurrentTaskHandle())) {
+            esp_err_t e = waitArbitrationWindow(m.data_length_code, timeout);
+            if (e != ESP_OK) return e;
+        }
+#if CANBUS_FAULT_INJECTION
+        if (faultState_.load() == FAULT_BUS_OFF) return ESP_ERR_INVALID_STATE;
+        twai_message_t out[3];
+        esp_err_t e = ESP_OK;
+        for (uint8_t i = 0, n = applyFault(FAULT_TX, m, nowUs(), out); i < n; ++i) {
+            esp_err_t r = transmitRaw(out[i], timeout);
+            if (e == ESP_OK) e = r;
+        }
+        return e;
+#else
+        return transmitRaw(m, timeout);
+#endif
+    }
+
+    esp_err_t transmitRaw(const twai_message_t& m, TickType_t timeout) {
+        CANBUS_PROFILE(PROF_TX);
+        esp_err_t e = twai_transmit(&m, timeout);
+        if (e == ESP_OK) trace(m, TRACE_TX, nowUs());
+        return e;
+    }
+
+#if CANBUS_FAULT_INJECTION
+    enum FaultAction : uint8_t { FA_PASS = 0, FA_DROP, FA_CORRUPT, FA_DUPLICATE, FA_DELAY, FA_REORDER };
+
+    struct FaultChannel {
+        uint32_t threshold[5] = {};     // kumulativ: drop, corrupt, duplicate, delay, reorder
+        uint32_t delayUs = 5000;
+        uint32_t rng = 1;
+        std::vector<char> script;
+        size_t pos = 0;
+        bool held = false;              // für reorder zurückgehaltener Frame
+        twai_message_t heldMsg{};
+        int64_t heldUs = 0;
+        FaultStats stats{};
+    };
+
+    struct DelayedFrame {
+        twai_message_t m;
+        int64_t dueUs;
+        uint8_t dir;
+    };
+
+    // TX läuft im Worker, ACKs im RX-Task oder handleReceive, Konfiguration in loop():
+    // faultLock_ (MutexLock) statt Spinlock, kein Critical Section, da delayed_/script
+    // allokieren. Treiberaufrufe erfolgen außerhalb.
+
+    static uint32_t xorshift(uint32_t& x) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    static FaultAction nextFault(FaultChannel& c) {
+        if (!c.script.empty()) {
+            char ch = c.script[c.pos];
+            c.pos = (c.pos + 1) % c.script.size();
+            switch (ch) {
+            case 'D': return FA_DROP;
+            case 'C': return FA_CORRUPT;
+            case 'U': return FA_DUPLICATE;
+            case 'L': return FA_DELAY;
+            case 'R': return FA_REORDER;
+            default:  return FA_PASS;
+            }
+        }
+        if (!c.threshold[4]) return FA_PASS;
+        uint32_t r = xorshift(c.rng);
+        for (int i = 0; i < 5; ++i)
+            if (r < c.threshold[i]) return static_cast<FaultAction>(FA_DROP + i);
+        return FA_PASS;
+    }
+
+    // Frame durch die Fault-Stufe schicken; out erhält die weiterzugebenden Frames (0..3)
+    uint8_t applyFault(FaultDir dir, const twai_message_t& m, int64_t nowUs, twai_message_t* out) {
+        MutexLock lock(faultLock_);
+        FaultChannel& c = faults_[dir];
+        ++c.stats.frames;
+        uint8_t n = 0;
+        switch (nextFault(c)) {
+        case FA_DROP:
+            ++c.stats.dropped;
+            return 0;
+        case FA_CORRUPT:
+            ++c.stats.corrupted;
+            out[n] = m;
+            if (m.data_length_code) {
+                uint32_t r = xorshift(c.rng);
+                out[n].data[r % m.data_length_code] ^= static_cast<uint8_t>(1u << ((r >> 8) & 7));
+            }
+            ++n;
+            break;
+        case FA_DUPLICATE:
+            ++c.stats.duplicated;
+            out[n++] = m;
+            out[n++] = m;
+            break;
+        case FA_DELAY:
+            ++c.stats.delayed;
+            delayed_.push_back(DelayedFrame{m, nowUs + c.delayUs, dir});
+            return 0;
+        case FA_REORDER:
+            if (!c.held) {
+                ++c.stats.reordered;
+                c.held = true;
+                c.heldMsg = m;
+                c.heldUs = nowUs;
+                return 0;
+            }
+            out[n++] = m;
+            break;
+        default:
+            out[n++] = m;
+            break;
+        }
+        if (c.held) {
+            out[n++] = c.heldMsg;
+            c.held = false;
+        }
+        return n;
+    }
+
+    // Fällige verzögerte Frames der Richtungen in dirs (Bitmaske 1 << FaultDir) weitergeben;
+    // ein Reorder-Frame ohne Nachfolger gilt nach delayMs als verzögert. Läuft in
+    // handleReceive, RX bei startRxTask() im RX-Task. Liefert ms bis zum nächsten fälligen
+    // Frame dieser Richtungen (UINT32_MAX: keiner).
+    uint32_t serviceFaults(uint8_t dirs = (1u << FAULT_TX) | (1u << FAULT_RX)) {
+        int64_t now = nowUs();
+        int64_t next = INT64_MAX;
+        std::vector<DelayedFrame> due;
+        {
+            MutexLock lock(faultLock_);
+            for (uint8_t dir = 0; dir < 2; ++dir) {
+                FaultChannel& c = faults_[dir];
+                if (!(dirs & (1u << dir)) || !c.held) continue;
+                int64_t at = c.heldUs + static_cast<int64_t>(c.delayUs);
+                if (at <= now) {
+                    due.push_back(DelayedFrame{c.heldMsg, now, dir});
+                    c.held = false;
+                } else next = std::min(next, at);
+            }
+            auto it = std::partition(delayed_.begin(), delayed_.end(),
+                                     [now, dirs, &next](const DelayedFrame& d) {
+                                         if (!(dirs & (1u << d.dir))) return true;
+                                         if (d.dueUs > now) { next = std::min(next, d.dueUs); return true; }
+                                         return false;
+                                     });
+            due.insert(due.end(), it, delayed_.end());
+            delayed_.erase(it, delayed_.end());
+        }
+        for (const DelayedFrame& d : due) {
+            if (d.dir == FAULT_TX) transmitRaw(d.m, 0);
+            else processFrame(d.m, now, true);
+        }
+        if (next == INT64_MAX) return UINT32_MAX;
+        return static_cast<uint32_t>(std::min<int64_t>((next - now + 999) / 1000, UINT32_MAX - 1));
+    }
+
+    uint32_t takeFaultAlerts() {
+        MutexLock lock(faultLock_);
+        uint32_t a = faultAlerts_;
+        faultAlerts_ = 0;
+        return a;
+    }
+
+    FaultChannel faults_[2];
+    std::vector<DelayedFrame> delayed_;
+    SemaphoreHandle_t faultLock_ = nullptr;
+    uint32_t faultAlerts_ = 0;
+    std::atomic<uint8_t> faultState_{FAULT_ERROR_ACTIVE};
+#endif
+
+    void trace(const twai_message_t& m, TraceDir dir, int64_t timeUs) {
+#if CANBUS_TRACE_SIZE > 0
+        uint32_t idx = traceHead_.fetch_add(1, std::memory_order_relaxed);
+        TraceEntry& e = trace_[idx & (CANBUS_TRACE_SIZE - 1)];
+        e.timeUs = timeUs;
+        e.identifier = m.identifier;
+        e.dlc = m.data_length_code;
+        e.dir = dir;
+        memcpy(e.data, m.data, 8);
+#else
+        (void)m; (void)dir; (void)timeUs;
+#endif
+    }
+
+    // Trace-Einträge vom ältesten zum neuesten durchlaufen
+    template<typename F>
+    void forEachTrace(F f) const {
+#if CANBUS_TRACE_SIZE > 0
+        uint32_t head = traceHead_.load(std::memory_order_relaxed);
+        uint32_t count = std::min<uint32_t>(head, CANBUS_TRACE_SIZE);
+        for (uint32_t i = head - count; i != head; ++i)
+            f(trace_[i & (CANBUS_TRACE_SIZE - 1)]);
+#else
+        (void)f;
+#endif
+    }
+
+    static void putLe16(uint8_t* p, uint16_t v) {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+    }
+
+    static void putLe32(uint8_t* p, uint32_t v) {
+        putLe16(p, static_cast<uint16_t>(v));
+        putLe16(p + 2, static_cast<uint16_t>(v >> 16));
+    }
+
+    // Letztes SYNC/FOLLOW_UP-Paar: t1 Master-Zeit, t2 lokale Empfangszeit
+    struct SyncPoint {
+        int64_t t1;
+        int64_t t2;
+        int32_t driftPpb;
+    };
+
+    static int64_t toMasterTime(const SyncPoint& p, int64_t local) {
+        int64_t dt = local - p.t2;
+        return p.t1 + dt + dt * p.driftPpb / 1000000000;
+    }
+
+    // Seqlock wie Mailbox: geschrieben in handleReceive, gelesen aus Sendepfaden
+    bool readSyncPoint(SyncPoint& out) const {
+        uint32_t spins = 0;
+        while (true) {
+            uint32_t s1 = syncSeq_.load(std::memory_order_acquire);
+            if (s1 & 1) {
+                seqlockBackoff(spins);
+                continue;
+            }
+            SyncPoint p = syncPoint_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (syncSeq_.load(std::memory_order_relaxed) != s1) {
+                seqlockBackoff(spins);
+                continue;
+            }
+            if (s1 == 0) return false;
+            out = p;
+            return true;
+        }
+    }
+
+    void writeSyncPoint(const SyncPoint& p) {
+        uint32_t s = syncSeq_.load(std::memory_order_relaxed);
+        syncSeq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        syncPoint_ = p;
+        syncSeq_.store(s + 2, std::memory_order_release);
+    }
+
+    // Master: SYNC mit Self-Reception senden. Der Empfang des eigenen Frames (Empfangspfad
+    // wie bei den Slaves, handleSyncFrame) liefert t1 und löst FOLLOW_UP aus; so gehört der
+    // Zeitstempel sicher zu diesem SYNC, auch wenn andere Tasks gleichzeitig senden.
+    void sendSync() {
+        // TT: SYNC und FOLLOW_UP zusammen in ein Arbitrierungsfenster legen
+        if (ttCycleUs_) {
+            int64_t slot = nextArbitrationSlot(std::max(nowUs(), ttBusyUntil_.load()),
+                                               frameUs(2) + frameUs(8));
+            if (slot > nowUs()) {
+                syncDue_ = slot;
+                return;
+            }
+        }
+        syncDue_ += syncPeriodUs_;
+        if (syncDue_ <= nowUs()) syncDue_ = nowUs() + syncPeriodUs_;
+        const uint8_t seq = ++syncTxSeq_;
+        twai_message_t m{};
+        m.identifier = buildId(3, 0x0F, SINGLE, ACK_TYPE_ID);
+        m.data_length_code = 2;
+        m.data[0] = SYNC_CODE;
+        m.data[1] = seq;
+        m.self = 1;
+        syncEcho_.store(seq);
+        if (transmit(m, 0) != ESP_OK) syncEcho_.store(-1);
+    }
+
+    void sendFollowUp(uint8_t seq, int64_t t1) {
+        twai_message_t m{};
+        m.identifier = buildId(3, 0x0F, SINGLE, ACK_TYPE_ID);
+        m.data_length_code = 8;
+        m.data[0] = FOLLOW_UP_CODE;
+        m.data[1] = seq;
+        for (int i = 0; i < 6; ++i) m.data[2 + i] = static_cast<uint8_t>(t1 >> (8 * i));
+        transmit(m, pdMS_TO_TICKS(10));
+    }
+
+    // Master: eigenen SYNC (Self-Reception) stempeln und FOLLOW_UP senden.
+    // Slave: SYNC stempeln, mit passendem FOLLOW_UP Offset und Drift nachführen
+    void handleSyncFrame(const twai_message_t& m, int64_t timeUs) {
+        if (m.data_length_code < 2) return;
+        if (syncRole_ == SYNC_MASTER) {
+            int16_t expected = m.data[1];
+            if (m.data[0] == SYNC_CODE && syncEcho_.compare_exchange_strong(expected, -1))
+                sendFollowUp(m.data[1], timeUs);
+            return;
+        }
+        if (syncRole_ != SYNC_SLAVE) return;
+        if (m.data[0] == SYNC_CODE) {
+            syncRxSeq_ = m.data[1];
+            syncRxUs_ = timeUs;
+            syncRxValid_ = true;
+            return;
+        }
+        if (m.data[0] != FOLLOW_UP_CODE || m.data_length_code < 8 ||
+            !syncRxValid_ || m.data[1] != syncRxSeq_)
+            return;
+        syncRxValid_ = false;
+        int64_t t1 = 0;
+        for (int i = 0; i < 6; ++i) t1 |= static_cast<int64_t>(m.data[2 + i]) << (8 * i);
+        const int64_t t2 = syncRxUs_;
+
+        SyncPoint last;
+        SyncPoint next{t1, t2, 0};
+        if (readSyncPoint(last)) {
+            const int64_t dl = t2 - last.t2;
+            const int64_t err = t1 - toMasterTime(last, t2);
+            syncStatus_.lastErrorUs = err;
+            if (dl <= 0 || dl > SYNC_MAX_INTERVAL_US || err > SYNC_RESET_US || err < -SYNC_RESET_US) {
+                ++syncStatus_.resets;
+                driftSamples_ = 0;
+            } else {
+                // Drift aus dem Intervall seit dem letzten Sync, geglättet. Zähler durch
+                // Fehler- und Driftgrenze beschränkt, in double trotzdem ohne Überlaufrisiko
+                double ppb = double(t1 - last.t1 - dl) * 1e9 / double(dl);
+                ppb = std::max(-500000.0, std::min(500000.0, ppb));
+                next.driftPpb = driftSamples_ > 0
+                    ? static_cast<int32_t>((3 * static_cast<int64_t>(last.driftPpb) + static_cast<int64_t>(ppb)) / 4)
+                    : static_cast<int32_t>(ppb);
+                ++driftSamples_;
+            }
+        }
+        writeSyncPoint(next);
+        syncStatus_.synced = true;
+        syncStatus_.driftPpb = next.driftPpb;
+        ++syncStatus_.syncs;
+    }
+
+    SyncRole syncRole_ = SYNC_OFF;
+    int64_t syncPeriodUs_ = 1000000;
+    int64_t syncDue_ = 0;
+    uint8_t syncTxSeq_ = 0;
+    std::atomic<int16_t> syncEcho_{-1};            // Master: erwarteter eigener SYNC (seq, -1 = keiner)
+    uint8_t syncRxSeq_ = 0;
+    int64_t syncRxUs_ = 0;
+    bool syncRxValid_ = false;
+    std::atomic<uint32_t> syncSeq_{0};
+    SyncPoint syncPoint_{};
+    TimeSyncStatus syncStatus_{};
+    uint32_t driftSamples_ = 0;                     // Drift-Schätzungen seit dem letzten Reset
+
+    // Nachricht in einem exklusiven TT-Fenster
+    struct TTEntry {
+        std::function<esp_err_t()> tx;
+        size_t window;
+        uint32_t latestUs;          // spätester Start im Fenster, damit alle Frames passen
+        int64_t done = -1;          // Beginn des zuletzt bedienten Fensters (busTimeUs)
+    };
+
+    // TT-Zeit: busTimeUs(), beim Slave erst nach dem ersten Sync
+    bool ttTime(int64_t& t) const {
+        SyncPoint p;
+        if (syncRole_ == SYNC_SLAVE && !readSyncPoint(p)) return false;
+        t = busTimeUs();
+        return true;
+    }
+
+    // Frühester Zeitpunkt >= from, ab dem lenUs vollständig in ein Arbitrierungsfenster
+    // passen (-1 = keines definiert oder alle zu kurz)
+    int64_t nextArbitrationSlot(int64_t from, int64_t lenUs) const {
+        const int64_t base = from - from % ttCycleUs_;
+        int64_t best = -1;
+        for (const TxWindow& w : ttWindows_) {
+            if (w.kind != WINDOW_ARBITRATION) continue;
+            for (int64_t cycle = base; cycle <= base + ttCycleUs_; cycle += ttCycleUs_) {
+                int64_t begin = std::max<int64_t>(from, cycle + w.startUs);
+                if (begin + lenUs > cycle + w.startUs + w.lengthUs) continue;
+                if (best < 0 || begin < best) best = begin;
+                break;
+            }
+        }
+        return best;
+    }
+
+    // Vor jedem Frame außerhalb der exklusiven Fenster: bis zu einem passenden
+    // Arbitrierungsfenster warten. ttBusyUntil_ schätzt das Ende der bereits an den Treiber
+    // übergebenen Frames, damit auch eine gefüllte TX-Queue nicht ins nächste Fenster ragt.
+    // Während des Wartens werden fällige TT-Nachrichten gesendet.
+    esp_err_t waitArbitrationWindow(uint8_t dlc, TickType_t timeout) {
+        const int64_t len = frameUs(dlc);
+        const int64_t deadline = timeout == portMAX_DELAY ? INT64_MAX
+            : nowUs() + static_cast<int64_t>(timeout) * portTICK_PERIOD_MS * 1000;
+        bool waited = false;
+        while (true) {
+            int64_t t;
+            if (!ttTime(t)) return ESP_ERR_INVALID_STATE;
+            int64_t busy = ttBusyUntil_.load();
+            int64_t begin = std::max(t, busy);
+            int64_t slot = nextArbitrationSlot(begin, len);
+            if (slot < 0) return ESP_ERR_INVALID_STATE;
+            if (slot == begin) {
+                if (ttBusyUntil_.compare_exchange_weak(busy, begin + len)) return ESP_OK;
+                continue;
+            }
+            if (!waited) { ttDeferred_.fetch_add(1); waited = true; }
+            if (nowUs() + (slot - t) > deadline) return ESP_ERR_TIMEOUT;
+            int64_t until = slot;
+            if (!txWorker_ || xTaskGetCurrentTaskHandle() == txWorker_)
+                until = std::min<int64_t>(until, t + int64_t(serviceTimeTriggered()) * 1000);
+            waitBusTime(until);
+        }
+    }
+
+    // Bis busTimeUs() >= target warten: vTaskDelay(n) blockiert höchstens n Ticks, daher
+    // ganze Ticks schlafen und nur den Rest unter einem Tick per Busy-Wait
+    void waitBusTime(int64_t target) {
+        const int64_t tickUs = int64_t(portTICK_PERIOD_MS) * 1000;
+        int64_t t;
+        while (ttTime(t) && t < target) {
+            const int64_t ticks = (target - t) / tickUs;
+            if (ticks > 0) vTaskDelay(static_cast<TickType_t>(ticks));
+        }
+    }
+
+    // Fällige TT-Nachrichten senden; weniger als 1 ms vor Fensterbeginn per waitBusTime
+    // (Busy-Wait nur unter einem Tick). Rückgabe: ms bis zum nächsten Fenster (max. 10)
+    uint32_t serviceTimeTriggered() {
+        if (!ttCycleUs_ || ttEntries_.empty() || ttServicing_) return 10;
+        ttServicing_ = true;
+        uint32_t waitMs = 10;
+        while (true) {
+            int64_t t;
+            if (!ttTime(t)) break;
+            // Frühestes offenes Fenster suchen; verpasste zählen
+            TTEntry* next = nullptr;
+            int64_t nextStart = 0;
+            for (TTEntry& e : ttEntries_) {
+                if (!e.tx) continue;
+                const TxWindow& w = ttWindows_[e.window];
+                int64_t start = t - t % ttCycleUs_ + w.startUs;
+                // Übersprungene Zyklen seit dem zuletzt bedienten Fenster sind verpasst
+                if (e.done >= 0 && start - e.done > ttCycleUs_) {
+                    ttMissed_ += static_cast<uint32_t>((start - e.done) / ttCycleUs_ - 1);
+                    e.done = start - ttCycleUs_;
+                }
+                if (start <= e.done) {
+                    start += ttCycleUs_;
+                } else if (t > start + e.latestUs) {
+                    ++ttMissed_;
+                    e.done = start;
+                    start += ttCycleUs_;
+                }
+                if (!next || start < nextStart) { next = &e; nextStart = start; }
+            }
+            if (!next) break;
+            if (nextStart - t >= 1000) {
+                waitMs = std::min<uint32_t>(waitMs, static_cast<uint32_t>((nextStart - t) / 1000));
+                break;
+            }
+            waitBusTime(nextStart);
+            ttOwner_.store(xTaskGetCurrentTaskHandle());
+            if (next->tx() == ESP_OK) ++ttSent_;
+            ttOwner_.store(nullptr);
+            next->done = nextStart;
+        }
+        ttServicing_ = false;
+        return waitMs;
+    }
+
+    uint32_t ttCycleUs_ = 0;
+    std::vector<TxWindow> ttWindows_;
+    std::vector<TTEntry> ttEntries_;
+    std::atomic<TaskHandle_t> ttOwner_{nullptr};  // sendet gerade im exklusiven Fenster
+    std::atomic<int64_t> ttBusyUntil_{0};
+    bool ttServicing_ = false;
+    uint32_t ttSent_ = 0;
+    uint32_t ttMissed_ = 0;
+    std::atomic<uint32_t> ttDeferred_{0};
+
+    // Alerts auswerten und Recovery vorantreiben (nicht blockierend)
+    void serviceBus() {
+        uint32_t alerts = 0;
+        if (twai_read_alerts(&alerts, 0) != ESP_OK) alerts = 0;
+#if CANBUS_FAULT_INJECTION
+        // RX-Frames stellt bei startRxTask() der RX-Task selbst zu
+        serviceFaults(rxTask_.load() ? (1u << FAULT_TX) : (1u << FAULT_TX) | (1u << FAULT_RX));
+        alerts |= takeFaultAlerts();
+#endif
+        if (alerts) handleAlerts(alerts);
+        if (syncRole_ == SYNC_MASTER && nowUs() >= syncDue_) sendSync();
+        if (recoveryPending_ &&
+            nowUs() >= recoveryDue_ &&
+            initiateRecovery() == ESP_OK)
+            recoveryPending_ = false;
+    }
+
+    // Bei simuliertem Bus-Off meldet die Fault-Stufe die Recovery selbst
+    esp_err_t initiateRecovery() {
+#if CANBUS_FAULT_INJECTION
+        if (faultState_.load() == FAULT_BUS_OFF) {
+            MutexLock lock(faultLock_);
+            faultAlerts_ |= TWAI_ALERT_BUS_RECOVERED;
+            return ESP_OK;
+        }
+#endif
+        return twai_initiate_recovery();
+    }
+
+    esp_err_t restart() {
+#if CANBUS_FAULT_INJECTION
+        if (faultState_.load() == FAULT_BUS_OFF) {
+            faultState_.store(FAULT_ERROR_ACTIVE);
+            return ESP_OK;
+        }
+#endif
+        return twai_start();
+    }
+
+    void handleAlerts(uint32_t alerts) {
+        int64_t now = nowUs();
+        if (alerts & TWAI_ALERT_RX_QUEUE_FULL) ++stats_.rxQueueFull;
+        if (alerts & TWAI_ALERT_ERR_PASS) ++stats_.errorPassive;
+        if (alerts & TWAI_ALERT_BUS_OFF) {
+            // Lange stabil gelaufen → Backoff zurücksetzen, sonst verdoppeln
+            if (stats_.busOff == 0 ||
+                now - busOffAt_ > static_cast<int64_t>(backoff_ + backoffMax_) * 1000)
+                backoff_ = backoffInitial_;
+            else
+                backoff_ = std::min(backoff_ * 2, backoffMax_);
+            ++stats_.busOff;
+            busOffAt_ = now;
+            if (autoRecovery_) {
+                recoveryPending_ = true;
+                recoveryDue_ = now + static_cast<int64_t>(backoff_) * 1000;
+            }
+        }
+        if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+            if (restart() == ESP_OK) {
+                uint32_t ms = static_cast<uint32_t>((nowUs() - busOffAt_) / 1000);
+                stats_.lastRecoveryMs = ms;
+                stats_.maxRecoveryMs = std::max(stats_.maxRecoveryMs, ms);
+                ++stats_.recoveries;
+            }
+        }
+        if (alertCb_) alertCb_(alerts);
+    }
+
+    // Zeitgesteuerte TX-Aufgaben; Rückgabe: ms bis zum nächsten Termin
+    uint32_t serviceTx() {
+        uint32_t waitMs = serviceTimeTriggered();
+        if (coalesce_) waitMs = std::min(waitMs, flushExpiredBundles());
+        return std::min(waitMs, serviceSchedule());
+    }
+    int64_t scheduleEpoch_ = 0;
+
+    // Einzelframe: Frame direkt aus msg füllen, kein Puffer, kein ACK.
+    // bundle = false (sendFromISR): nie bündeln. Direkt gesendete Frames schicken das
+    // Bündel derselben Zieladresse vorher ab, damit sie es nicht überholen.
+    template<typename T>
+    esp_err_t sendImpl(uint8_t prio, uint8_t addr, const T& msg, std::true_type, bool bundle = true) {
+        constexpr uint8_t type = MsgType<T>::TypeID;
+        if (coalesce_) {
+            if (sizeof(T) < 8 && bundle)
+                return enqueueBundle(prio, addr, type, reinterpret_cast<const uint8_t*>(&msg), sizeof(T));
+            esp_err_t e = flushBundle(addr & 0x0F);
+            if (e != ESP_OK) return e;
+        }
+        twai_message_t m{};
+        m.identifier = buildId(prio, addr, SINGLE, type);
+        m.extd = 0;
+        m.data_length_code = TxLayout<T>::len;
+        memcpy(m.data, &msg, sizeof(T));
+#if CANBUS_LATENCY_TRACE
+        if (TxLayout<T>::trailer) stampTrailer(m.data + sizeof(T));
+#endif
+        return transmit(m, pdMS_TO_TICKS(100));
+    }
+
+    // Mehrframe: Frameanzahl und Länge des END-Frames sind constexpr aus sizeof(T)
+    template<typename T>
+    esp_err_t sendImpl(uint8_t prio, uint8_t addr, const T& msg, std::false_type, bool = true) {
+        constexpr uint8_t type   = MsgType<T>::TypeID;
+        constexpr size_t  len    = TxLayout<T>::len;
+        constexpr size_t  total  = len + 1;                    // Payload + CRC
+        constexpr size_t  frames = (total + 7) / 8;
+        constexpr size_t  last   = total - (frames - 1) * 8;   // 1..8 Byte, CRC am Ende
+#if CANBUS_LATENCY_TRACE
+        uint8_t buf[len];
+        memcpy(buf, &msg, sizeof(T));
+        if (TxLayout<T>::trailer) stampTrailer(buf + sizeof(T));
+        const uint8_t* raw = buf;
+#else
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&msg);
+#endif
+        const uint8_t crc = crc8(raw, len);
+        if (coalesce_) {
+            esp_err_t e = flushBundle(addr & 0x0F);
+            if (e != ESP_OK) return e;
+        }
+        const uint32_t idStart  = buildId(prio, addr, START, type);
+        const uint32_t idMiddle = buildId(prio, addr, MIDDLE, type);
+        const uint32_t idEnd    = buildId(prio, addr, END, type);
+
+        uint8_t attempts = 0;
+        while (true) {
+            twai_message_t m{};
+            m.extd = 0;
+            m.data_length_code = 8;
+            for (size_t i = 0; i + 1 < frames; ++i) {
+                m.identifier = (i == 0) ? idStart : idMiddle;
+                memcpy(m.data, raw + i * 8, 8);
+                esp_err_t e = transmit(m, pdMS_TO_TICKS(100));
+                if (e != ESP_OK) return e;
+            }
+            m.identifier = idEnd;
+            m.data_length_code = last;
+            memcpy(m.data, raw + (frames - 1) * 8, last - 1);
+            m.data[last - 1] = crc;
+            esp_err_t e = transmit(m, pdMS_TO_TICKS(100));
+            if (e != ESP_OK) return e;
+
+            if (retryLimit_ == 0) return ESP_OK;
+            // Auf ACK warten
+            if (waitAck(type)) return ESP_OK;
+            // Retry-Limit erreicht?
+            if (++attempts > retryLimit_) break;
+        }
+        // Fehler-Callback
+        if (errorCb_) errorCb_(type, addr);
+        return ESP_FAIL;
+    }
+
+    // Fällige Einträge senden; Rückgabe: ms bis zum nächsten Termin (max. 10)
+    uint32_t serviceSchedule() {
+        uint32_t waitMs = 10;
+        if (schedule_.empty()) return waitMs;
+        int64_t now = nowUs();
+        for (CyclicEntry& e : schedule_) {
+            if (!e.tx) continue;
+            const int64_t period = static_cast<int64_t>(e.period) * 1000;
+            if (now >= e.next) {
+                e.tx();
+                // Termine an der Epoche ausrichten (kein Drift); verpasste Zyklen nicht nachholen
+                e.next += period;
+                if (e.next <= now) e.next += period * ((now - e.next) / period + 1);
+            }
+            int64_t left = (e.next - now) / 1000;
+            if (left < waitMs) waitMs = static_cast<uint32_t>(left);
+        }
+        return waitMs;
+    }
+
+    // Offset in der Mitte der größten Lücke zwischen vorhandenen Phasen (modulo Periode)
+    uint32_t autoPhase(uint32_t periodMs) const {
+        std::vector<uint32_t> phases;
+        for (const CyclicEntry& e : schedule_)
+            if (e.tx) phases.push_back(e.phase % periodMs);
+        if (phases.empty()) return 0;
+        std::sort(phases.begin(), phases.end());
+        uint32_t bestStart = phases.back();
+        uint32_t bestGap = phases.front() + periodMs - phases.back();
+        for (size_t i = 1; i < phases.size(); ++i) {
+            if (phases[i] - phases[i - 1] > bestGap) {
+                bestGap = phases[i] - phases[i - 1];
+                bestStart = phases[i - 1];
+            }
+        }
+        return (bestStart + bestGap / 2) % periodMs;
+    }
+
+    // Sub-Header je Nachricht: [6..4] Type-ID, [3..0] Länge, danach die Nutzdaten
+    esp_err_t enqueueBundle(uint8_t prio, uint8_t addr, uint8_t type, const uint8_t* data, uint8_t len) {
+        Bundle& b = bundles_[addr & 0x0F];
+        if (b.len + 1 + len > 8) {
+            esp_err_t e = flushBundle(addr & 0x0F);
+            if (e != ESP_OK) return e;
+        }
+        if (b.len == 0) {
+            b.prio = prio;
+            b.since = nowUs();
+        }
+        b.prio = std::max(b.prio, prio);
+        b.data[b.len++] = static_cast<uint8_t>(((type & 0x07) << 4) | len);
+        memcpy(b.data + b.len, data, len);
+        b.len += len;
+        // Kein Platz mehr für eine weitere Nachricht (Header + min. 1 Byte). Die Nachricht
+        // ist angenommen; ein Sendefehler kommt über onError, das Bündel bleibt erhalten
+        if (b.len + 2 > 8) flushBundle(addr & 0x0F);
+        return ESP_OK;
+    }
+
+    esp_err_t flushBundle(uint8_t addr) {
+        Bundle& b = bundles_[addr];
+        if (b.len == 0) return ESP_OK;
+        twai_message_t m{};
+        m.identifier = buildId(b.prio, addr, SINGLE, BUNDLE_TYPE_ID);
+        m.extd = 0;
+        m.data_length_code = b.len;
+        memcpy(m.data, b.data, b.len);
+        esp_err_t e = transmit(m, pdMS_TO_TICKS(100));
+        if (e == ESP_OK) {
+            b.len = 0;
+            return ESP_OK;
+        }
+        // Bündel bleibt erhalten, nächster Versuch nach einer weiteren Deadline
+        b.since = nowUs();
+        if (errorCb_) errorCb_(BUNDLE_TYPE_ID, addr);
+        return e;
+    }
+
+    // Abgelaufene Bündel senden; Rückgabe: ms bis zur nächsten Deadline (aufgerundet, max. 10)
+    uint32_t flushExpiredBundles() {
+        uint32_t waitMs = 10;
+        int64_t now = nowUs();
+        const int64_t deadline = static_cast<int64_t>(coalesceDeadline_) * 1000;
+        for (uint8_t addr = 0; addr < 16; ++addr) {
+            if (bundles_[addr].len == 0) continue;
+            int64_t left = bundles_[addr].since + deadline - now;
+            if (left <= 0) flushBundle(addr);
+            else waitMs = std::min<uint32_t>(waitMs, static_cast<uint32_t>((left + 999) / 1000));
+        }
+        return waitMs;
+    }
+
+    void unbundle(const twai_message_t& m, const RxInfo& info) {
+        uint8_t pos = 0;
+        while (pos < m.data_length_code) {
+            uint8_t hdr = m.data[pos++];
+            uint8_t len = hdr & 0x0F;
+            if (len == 0 || pos + len > m.data_length_code) return;
+            std::vector<uint8_t> d(m.data + pos, m.data + pos + len);
+            dispatch(info.prio, (hdr >> 4) & 0x07, d, info);
+            pos += len;
+        }
+    }
+
+    // Bis 100 ms auf das ACK warten, ohne die CPU zu belegen: empfängt derselbe Task sonst
+    // per handleReceive() (oder noch niemand), liest er den Treiber selbst; andernfalls
+    // blockiert er, bis der Empfangspfad (RX-Task, handleReceive() in einem anderen Task)
+    // ein ACK meldet
+    bool waitAck(uint8_t type) {
+        const int64_t deadline = nowUs() + 100000;
+        const TaskHandle_t owner = rxOwner_.load(std::memory_order_relaxed);
+        const bool receiveHere = !rxTask_ && !txWorker_ && (!owner || owner == xTaskGetCurrentTaskHandle());
+        while (true) {
+            uint8_t expected = ACK_PENDING | type;
+            if (pendingAck_.compare_exchange_strong(expected, 0)) return true;
+            int64_t left = deadline - nowUs();
+            if (left <= 0) return false;
+            TickType_t ticks = pdMS_TO_TICKS(static_cast<uint32_t>((left + 999) / 1000));
+            if (receiveHere) {
+                twai_message_t m;
+                if (twai_receive(&m, ticks) == ESP_OK) receiveFrame(m, nowUs());
+            } else {
+                xSemaphoreTake(ackSem_, ticks);
             }
         }
-        return false;
     }
 
     void sendAck(uint8_t to, uint8_t type) {
@@ -196,41 +2487,106 @@ private:
         a.extd = 0;
         a.data_length_code = 1;
         a.data[0] = type;
-        twai_transmit(&a, pdMS_TO_TICKS(20));
+        transmit(a, pdMS_TO_TICKS(20));
     }
 
-    static bool expired(
-        const std::chrono::steady_clock::time_point& t0,
-        const std::chrono::steady_clock::time_point& now) {
-        return std::chrono::duration_cast<std::chrono::milliseconds>(now - t0).count() > REASSEMBLY_TIMEOUT;
+    // Markiert Nachrichten mit Latenz-Trailer auf dem Weg zu deliver() (auch durch die RX-Ringe)
+    static constexpr uint8_t STAMPED = CANBUS_LATENCY_TRACE ? 0x80 : 0;
+
+#if CANBUS_LATENCY_TRACE
+    void stampTrailer(uint8_t* p) const {
+        uint16_t t = static_cast<uint16_t>(busTimeUs() >> 4);
+        p[0] = static_cast<uint8_t>(t);
+        p[1] = static_cast<uint8_t>(t >> 8);
+        p[2] = nodeAddress_;
     }
 
-    static uint8_t crc8(const uint8_t* data, size_t len) {
-        uint8_t crc = 0;
-        for (size_t i = 0; i < len; ++i) {
-            crc ^= data[i];
-            for (int j = 0; j < 8; ++j) {
-                crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
-            }
-        }
-        return crc;
+    void recordLatency(uint8_t type, const std::vector<uint8_t>& data) {
+        if (data.size() < LATENCY_TRAILER) return;
+        const uint8_t* p = data.data() + data.size() - LATENCY_TRAILER;
+        uint16_t sent = static_cast<uint16_t>(p[0] | (p[1] << 8));
+        uint16_t now = static_cast<uint16_t>(busTimeUs() >> 4);
+        uint32_t us = static_cast<uint32_t>(static_cast<uint16_t>(now - sent)) << 4;
+        latencyType_[type].record(us);
+        latencySource_[p[2] & 0x0F].record(us);
+        if (latencyDeadline_ && us > latencyDeadline_) latencyMisses_[type].fetch_add(1);
+    }
+
+    Histogram latencyType_[8];
+    Histogram latencySource_[16];
+    std::atomic<uint32_t> latencyMisses_[8] = {};
+    std::atomic<uint32_t> latencyUnstamped_[8] = {};
+    uint32_t latencyDeadline_ = 0;
+#endif
+
+    uint8_t crc8(const uint8_t* data, size_t len) {
+        CANBUS_PROFILE(PROF_CRC);
+        return CANReassembler::crc8(data, len);
     }
 
+    // Priorität invertiert in Bit 10..9: auf dem Bus gewinnt der kleinere Identifier,
+    // damit setzt sich Priorität 3 (Bits 00) in der Arbitrierung durch
     static uint32_t buildId(uint8_t prio, uint8_t addr, uint8_t seq, uint8_t type) {
-        return ((static_cast<uint32_t>(prio & 0x03) << 9) |
+        return ((static_cast<uint32_t>(3 - (prio & 0x03)) << 9) |
                 (static_cast<uint32_t>(addr & 0x0F) << 5) |
                 (static_cast<uint32_t>(seq & 0x03) << 3) |
                 (type & 0x07));
     }
 
-    void dispatch(uint8_t type, const std::vector<uint8_t>& data) {
+    // Zustellung direkt oder über die Übergabe-Queue (setDeferredDelivery)
+    void dispatch(uint8_t prio, uint8_t type, const std::vector<uint8_t>& data, const RxInfo& info) {
+        CANBUS_PROFILE(PROF_DISPATCH);
+        if (!deferred_) { deliver(type, data, info); return; }
+        Backpressure policy = rxPolicy_;
+        if (policy == BLOCK && xTaskGetCurrentTaskHandle() != rxTask_.load())
+            policy = DROP_NEWEST;           // Konsument evtl. derselbe Task: nie warten
+        if (rxRings_[prio & 0x03].push(type, data.data(), data.size(), info, policy,
+                                       pdMS_TO_TICKS(CANBUS_RX_BLOCK_MS)) && rxNotify_)
+            xTaskNotifyGive(rxNotify_);
+    }
+
+    // Handler erhalten die Daten samt Trailer; sie lesen nur sizeof(T) Byte
+    void deliver(uint8_t type, const std::vector<uint8_t>& data, const RxInfo& info) {
+#if CANBUS_LATENCY_TRACE
+        if (type & STAMPED) {
+            type &= 0x07;
+            // Trailer nur, wenn er beim Sender keinen Frame gekostet hat (TxLayout);
+            // ohne Handler ist sizeof(T) unbekannt, dann wird nicht gemessen
+            if (rxSize_[type]) {
+                if (data.size() == rxSize_[type] + LATENCY_TRAILER) recordLatency(type, data);
+                else latencyUnstamped_[type].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+#endif
         auto it = handlers_.find(type);
-        if (it != handlers_.end()) it->second(data);
+        if (it != handlers_.end()) it->second(data, info);
     }
 };
 
+#undef CANBUS_PROFILE
+
+// Type-ID 0..6 (7 = ACK; 6 ist bei aktivem Coalescing für Bündel reserviert)
 #define DEFINE_CAN_MESSAGE(Name, ID, ...) \
     struct Name { __VA_ARGS__ }; \
-    template<> struct CANBus::MsgTraits<Name, ID> { using type = Name; static constexpr uint8_t TypeID = ID; };
+    static_assert((ID) < CANBus::ACK_TYPE_ID, #Name ": Type-ID muss 0..6 sein (3 Bit, 7 = ACK)"); \
+    template<> struct CANBus::MsgTraits<Name, ID> { using type = Name; static constexpr uint8_t TypeID = ID; }; \
+    template<> struct CANBus::MsgType<Name> { static constexpr uint8_t TypeID = ID; };
+
+// Wie DEFINE_CAN_MESSAGE, zusätzlich Priorität, Periode und Deadline (ms) für die
+// Antwortzeitanalyse: Registrierung in CANRta::registry(), Prüfung zur Compile-Zeit, dass
+// die Nachricht allein in ihre Deadline passt (bei 1 Mbit/s; die tatsächliche Baudrate an
+// CANRta(bus.bitrate()) übergeben). Name::CAN_PRIO für send().
+#define DEFINE_CAN_MESSAGE_TIMED(Name, ID, PRIO, PERIOD_MS, DEADLINE_MS, ...) \
+    struct Name { __VA_ARGS__ \
+        static constexpr uint8_t CAN_PRIO = PRIO; \
+        static constexpr uint32_t CAN_PERIOD_MS = PERIOD_MS; \
+        static constexpr uint32_t CAN_DEADLINE_MS = DEADLINE_MS; }; \
+    static_assert((ID) < CANBus::ACK_TYPE_ID, #Name ": Type-ID muss 0..6 sein (3 Bit, 7 = ACK)"); \
+    template<> struct CANBus::MsgTraits<Name, ID> { using type = Name; static constexpr uint8_t TypeID = ID; }; \
+    template<> struct CANBus::MsgType<Name> { static constexpr uint8_t TypeID = ID; }; \
+    static_assert(CANRta::transmitNs(CANBus::TxLayout<Name>::len, CANBus::MAX_BITRATE) <= \
+                  (DEADLINE_MS) * 1000000ull, #Name ": Deadline kürzer als die Übertragungsdauer"); \
+    static const CANRta::Registrar Name##RtaRegistrar_(#Name, ID, PRIO, CANBus::TxLayout<Name>::len, \
+                                                       PERIOD_MS, DEADLINE_MS);
 
 #endif // ESP32_CAN_LIBRARY_H
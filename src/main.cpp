@@ -18,12 +18,12 @@ DEFINE_CAN_MESSAGE(HeartbeatMsg, 2,
 // 2) Definiere “mittlere” Pakete
 // -----------------------------
 // TempHumMsg: 8 Byte Payload (float temperature + float humidity)
-DEFINE_CAN_MESSAGE(TempHumMsg,  10,
+DEFINE_CAN_MESSAGE(TempHumMsg,  3,
     float temperature;   // Temperatur in °C
     float humidity;      // Relative Luftfeuchte in %
 );
 // PressureMsg: 5 Byte Payload (float pressure + uint8_t unit)
-DEFINE_CAN_MESSAGE(PressureMsg, 11,
+DEFINE_CAN_MESSAGE(PressureMsg, 4,
     float pressure;      // Druckwert (z. B. in Pascal)
     uint8_t unit;        // Einheitscode (z. B. 0=Pa, 1=bar, 2=psi)
 );
@@ -37,7 +37,7 @@ struct ConfigBlock {
     uint8_t  data[60];   // Nutzdaten (z. B. Parameter‑Array)
 };
 // ConfigMsg nutzt ConfigBlock und wird automatisch fragmentiert
-DEFINE_CAN_MESSAGE(ConfigMsg, 20,
+DEFINE_CAN_MESSAGE(ConfigMsg, 5,
     ConfigBlock cfg;
 );
 
@@ -47,6 +47,15 @@ DEFINE_CAN_MESSAGE(ConfigMsg, 20,
 // TX-Pin = GPIO5, RX-Pin = GPIO4, 500 kb/s, Normal‑Modus
 CANBus can(GPIO_NUM_5, GPIO_NUM_4);
 
+// -----------------------------
+// Zyklisch gesendete Nachrichten
+// -----------------------------
+// Der Scheduler hält Referenzen auf diese Objekte; Änderungen werden
+// beim nächsten Zyklus automatisch mitgesendet.
+StatusMsg  st{ 1, 0 };                // state = 1 (“Bereit”), errorCode = 0
+TempHumMsg th{ 23.7f, 51.2f };        // Temperatur in °C, Luftfeuchte in %
+ConfigMsg  cfg;
+
 void setup() {
     // -------------------------
     // 1) Seriellen Monitor starten
@@ -91,49 +100,22 @@ void setup() {
         Serial.printf("[Large] Config-ID=%u, FirstByte=%u\n",
                       m.cfg.id, m.cfg.data[0]);
     });
+
+    // ---------------------------
+    // 5) Zyklische Sendungen registrieren
+    // ---------------------------
+    // Phase wird automatisch versetzt, damit die drei Nachrichten
+    // nicht gleichzeitig auf den Bus gehen.
+    cfg.cfg.id = 42;                                  // ID = 42
+    memset(cfg.cfg.data, 0xFF, sizeof(cfg.cfg.data)); // Fülle Daten mit 0xFF
+    can.schedule<StatusMsg>(0, 3, st, 1000);      // Priorität 0, an Node 3, 1 s
+    can.schedule<TempHumMsg>(1, 4, th, 1000);     // Priorität 1, an Node 4, 1 s
+    can.schedule<ConfigMsg>(3, 5, cfg, 1000);     // Priorität 3, an Node 5, 1 s
 }
 
 void loop() {
     // -----------------------------
-    // 1) Eingehende CAN‑Nachrichten verarbeiten
-    // -----------------------------
-    can.handleReceive();  // Fragment‑Reassembly & Dispatch
-
-    // -----------------------------
-    // 2) StatusMsg senden (klein)
-    // -----------------------------
-    StatusMsg st{ 
-        1,      // state = 1 (z. B. “Bereit”)
-        0       // errorCode = 0 (kein Fehler)
-    };
-    can.send<StatusMsg>(0,  // Priorität: 0 (niedrig)
-                        3,  // Adresse: 3 (Empfänger‑Node)
-                        st);
-
-    // -----------------------------
-    // 3) TempHumMsg senden (mittel)
-    // -----------------------------
-    TempHumMsg th{
-        23.7f,  // Temperatur in °C
-        51.2f   // Luftfeuchte in %
-    };
-    can.send<TempHumMsg>(1,  // Priorität: 1 (mittel)
-                         4,  // Adresse: 4
-                         th);
-
-    // -----------------------------
-    // 4) ConfigMsg senden (groß)
-    // -----------------------------
-    ConfigBlock cb;
-    cb.id = 42;                         // ID = 42
-    memset(cb.data, 0xFF, sizeof(cb.data));  // Fülle Daten mit 0xFF
-    ConfigMsg cfg{ cb };
-    can.send<ConfigMsg>(3,  // Priorität: 3 (hoch)
-                        5,  // Adresse: 5
-                        cfg);
-
-    // -----------------------------
-    // 5) Eine Sekunde warten
+    // Eingehende CAN‑Nachrichten verarbeiten und zyklische Nachrichten senden
     // -----------------------------
-    delay(1000);
+    can.handleReceive();  // Fragment‑Reassembly, Dispatch & Scheduler
 }
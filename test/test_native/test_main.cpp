@@ -0,0 +1,1232 @@
+// Native Tests (pio test -e native): Library gegen den Host-Shim in tools/host
+#include <unity.h>
+#include "host_twai.h"
+#include "esp32_can_library.h"
+#include "capture_replay.h"
+#include <cstdio>
+#include <atomic>
+#include <new>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+DEFINE_CAN_MESSAGE(PingMsg, 0, uint16_t value;);
+DEFINE_CAN_MESSAGE(BlobMsg, 0, uint8_t bytes[20];);
+DEFINE_CAN_MESSAGE(StatusMsg, 1, uint8_t state;);
+DEFINE_CAN_MESSAGE(SampleMsg, 2, float temperature; float humidity;);
+DEFINE_CAN_MESSAGE(AliasMsg, 2, uint8_t raw;);                 // gleiche Type-ID wie SampleMsg
+
+// Identifier-Layout wie CANBus::buildId: prio 10..9 (invertiert), addr 8..5, seq 4..3, type 2..0
+static uint32_t canId(uint8_t prio, uint8_t addr, uint8_t seq, uint8_t type) {
+    return (uint32_t(3 - (prio & 0x03)) << 9) | (uint32_t(addr & 0x0F) << 5) | (uint32_t(seq & 0x03) << 3) | (type & 0x07);
+}
+
+// Bus mit Tasks, die bis Prozessende laufen: statischer Speicher ohne Destruktor nach main()
+#define PERSISTENT_BUS(name, ...) \
+    alignas(CANBus) static unsigned char name##Mem_[sizeof(CANBus)]; \
+    static CANBus& name = *new (name##Mem_) CANBus(__VA_ARGS__)
+
+extern "C" void setUp() {
+    hostTwaiReset();
+    CANBus::VirtualClock::set(1000000);
+    CANBus::VirtualClock::setStep(0);
+}
+
+extern "C" void tearDown() {}
+
+// Fragmente einer Nachricht wie sendImpl: START/MIDDLE..., END mit CRC-Byte
+static std::vector<twai_message_t> fragments(uint8_t type, const uint8_t* data, size_t len) {
+    std::vector<twai_message_t> out;
+    std::vector<uint8_t> bytes(data, data + len);
+    bytes.push_back(CANReassembler::crc8(data, len));
+    for (size_t off = 0; off < bytes.size(); off += 8) {
+        uint8_t seq = off == 0 ? CANBus::START : off + 8 >= bytes.size() ? CANBus::END : CANBus::MIDDLE;
+        uint8_t dlc = static_cast<uint8_t>(std::min<size_t>(8, bytes.size() - off));
+        out.push_back(hostTwaiFrame(canId(0, 0, seq, type), &bytes[off], dlc));
+    }
+    return out;
+}
+
+static void test_inject_single_frame() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    int got = 0;
+    uint16_t value = 0;
+    bus.onReceive<PingMsg>([&](const PingMsg& m) { ++got; value = m.value; });
+    uint8_t d[2] = {0x34, 0x12};
+    bus.injectFrame(canId(0, 0, CANBus::SINGLE, 0), d, 2, 0);
+    TEST_ASSERT_EQUAL(1, got);
+    TEST_ASSERT_EQUAL_HEX16(0x1234, value);
+}
+
+static void test_loopback_fragmented_roundtrip() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(0);
+    hostTwaiSetLoopback(true);
+    int got = 0;
+    BlobMsg rx{};
+    bus.onReceive<BlobMsg>([&](const BlobMsg& m) { ++got; rx = m; });
+    BlobMsg tx;
+    for (uint8_t i = 0; i < sizeof(tx.bytes); ++i) tx.bytes[i] = static_cast<uint8_t>(i * 7);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(1, 2, tx));
+    TEST_ASSERT_EQUAL(3, hostTwaiSent().size());
+    for (int i = 0; i < 5 && !got; ++i) bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, got);
+    TEST_ASSERT_EQUAL_MEMORY(tx.bytes, rx.bytes, sizeof(tx.bytes));
+}
+
+// Type-ID aus DEFINE_CAN_MESSAGE: jeder Typ hat seinen eigenen Handler
+static void test_dispatch_by_type_id() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    int status = 0, sample = 0;
+    uint8_t dest = 0;
+    bus.onReceive<StatusMsg>([&](const StatusMsg& m, const CANBus::RxInfo& info) {
+        status += m.state;
+        dest = info.dest;
+    });
+    bus.onReceive<SampleMsg>([&](const SampleMsg&) { ++sample; });
+    uint8_t d[8] = {5};
+    bus.injectFrame(canId(0, 9, CANBus::SINGLE, 1), d, 1, 0);
+    bus.injectFrame(canId(0, 0, CANBus::SINGLE, 2), d, 8, 0);
+    TEST_ASSERT_EQUAL(5, status);
+    TEST_ASSERT_EQUAL(9, dest);                         // Zieladresse aus Bit 8..5
+    TEST_ASSERT_EQUAL(1, sample);
+}
+
+// Publish-Policy gilt nur für ihren Typ; fremder Typ mit gleicher Type-ID wird abgewiesen
+static void test_publish_policy_per_type() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(0);
+    bus.setPublishPolicy<SampleMsg>(CANBus::Deadband<SampleMsg>().field(&SampleMsg::temperature, 0.5f), 0);
+    StatusMsg st{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.publish<StatusMsg>(0, 1, st));
+    st.state = 2;
+    TEST_ASSERT_EQUAL(ESP_OK, bus.publish<StatusMsg>(0, 1, st));
+    TEST_ASSERT_EQUAL(2, hostTwaiSent().size());
+
+    SampleMsg sm{20.0f, 50.0f};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.publish<SampleMsg>(0, 1, sm));
+    sm.temperature = 20.2f;
+    TEST_ASSERT_EQUAL(ESP_OK, bus.publish<SampleMsg>(0, 1, sm));
+    TEST_ASSERT_EQUAL(1, hostTwaiSent().size());
+
+    AliasMsg alias{7};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bus.publish<AliasMsg>(0, 1, alias));
+    TEST_ASSERT_EQUAL(0, hostTwaiSent().size());
+}
+
+// publish() aus mehreren Tasks (TX-Worker): letzte Werte je Adresse bleiben konsistent
+static void test_publish_from_multiple_tasks() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker(256));
+    std::atomic<int> sentOk{0};
+    std::vector<std::thread> tasks;
+    for (uint8_t t = 0; t < 4; ++t) {
+        tasks.emplace_back([t, &sentOk]() {
+            for (uint16_t i = 0; i < 200; ++i) {
+                PingMsg ping{static_cast<uint16_t>(i / 2)};     // jeder zweite Wert unverändert
+                if (bus.publish<PingMsg>(0, t, ping) == ESP_OK) ++sentOk;
+                bus.setPublishPolicy<StatusMsg>(nullptr, 0);
+                if (i % 16 == 0) usleep(1000);
+            }
+        });
+    }
+    for (std::thread& th : tasks) th.join();
+    TEST_ASSERT_EQUAL(800, sentOk.load());
+    usleep(50000);
+    TEST_ASSERT_EQUAL(400, hostTwaiSent().size());
+}
+
+// Coalescing: Bündel tragen die Type-ID je Nachricht, Deadline < 10 ms wird eingehalten
+static void test_bundle_types_and_deadline() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setCoalescing(true, 3);
+    hostTwaiSetLoopback(true);
+    int pings = 0, states = 0;
+    bus.onReceive<PingMsg>([&](const PingMsg& m) { pings += m.value; });
+    bus.onReceive<StatusMsg>([&](const StatusMsg& m) { states += m.state; });
+    PingMsg ping{0x0102};
+    StatusMsg st{9};
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<PingMsg>(0, 1, ping));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 1, st));
+    TEST_ASSERT_EQUAL(0, hostTwaiSent().size());
+    while (!states && esp_timer_get_time() - start < 50000) bus.handleReceive();
+    int64_t took = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL(0x0102, pings);
+    TEST_ASSERT_EQUAL(9, states);
+    TEST_ASSERT_LESS_THAN(9000, took);
+}
+
+// schedule() nach langer Laufzeit: erster Termin an der Epoche ausgerichtet, ohne Schleife
+// über alle verpassten Perioden
+static void test_schedule_aligns_after_long_uptime() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setClock(&CANBus::VirtualClock::now);
+    static StatusMsg st{1};
+    static PingMsg ping{2};
+    bus.unschedule(bus.schedule<StatusMsg>(0, 1, st, 1000, 0));    // Epoche = 1 s
+    CANBus::VirtualClock::advance(86400LL * 1000000 + 250000);       // ein Tag + 250 ms
+    int64_t before = esp_timer_get_time();
+    bus.unschedule(bus.schedule<PingMsg>(0, 1, ping, 1, 0));     // 86 Mio. verpasste Perioden
+    TEST_ASSERT_LESS_THAN(50000, esp_timer_get_time() - before);
+    bus.schedule<PingMsg>(0, 1, ping, 1000, 0);
+    bus.handleReceive();                                        // nächster Termin in 750 ms
+    TEST_ASSERT_EQUAL(0, hostTwaiSent().size());
+    CANBus::VirtualClock::advance(750000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, hostTwaiSent().size());
+}
+
+static int64_t cpuUs() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Gegenstelle: quittiert jede fragmentierte Nachricht nach delayMs mit einem ACK-Frame
+static void ackPeer(uint32_t delayMs) {
+    hostTwaiOnTransmit([delayMs](const twai_message_t& m) {
+        if (((m.identifier >> 3) & 0x03) != CANBus::END) return;
+        uint8_t type = m.identifier & 0x07;
+        twai_message_t ack = hostTwaiFrame(canId(3, 0, CANBus::SINGLE, CANBus::ACK_TYPE_ID), &type, 1);
+        if (!delayMs) { hostTwaiInject(ack); return; }
+        std::thread([ack, delayMs]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            hostTwaiInject(ack);
+        }).detach();
+    });
+}
+
+// Ohne Worker und RX-Task: der Sender liest das ACK selbst aus dem Treiber
+static void test_wait_ack_receives_inline() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(1);
+    ackPeer(0);
+    BlobMsg blob{};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(1, 2, blob));
+    TEST_ASSERT_EQUAL(3, hostTwaiSent().size());
+}
+
+// TX-Worker wartet blockierend; das ACK verarbeitet handleReceive() im Anwendungs-Task
+static void test_worker_waits_for_ack_without_spinning() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(1);
+    static int errors = 0;
+    bus.onError([](uint8_t, uint8_t) { ++errors; });
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker());
+    ackPeer(60);
+    BlobMsg blob{};
+    int64_t cpu = cpuUs();
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(1, 2, blob));
+    int64_t start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < 150000) bus.handleReceive();
+    cpu = cpuUs() - cpu;
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(3, hostTwaiSent().size());        // keine Wiederholung
+    TEST_ASSERT_LESS_THAN(40000, cpu);
+}
+
+// Nach startTxWorker(): schedule() nur noch im Worker, flush()/setCoalescing() eingereiht
+static void test_worker_owns_schedule_and_bundles() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    static PingMsg ping{1};
+    size_t handle = bus.schedule<PingMsg>(0, 1, ping, 1000);
+    TEST_ASSERT_NOT_EQUAL(CANBus::INVALID_HANDLE, handle);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker());
+    TEST_ASSERT_EQUAL(CANBus::INVALID_HANDLE, bus.schedule<PingMsg>(0, 1, ping, 1000));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.unschedule(handle));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setCoalescing(true, 1000));
+    StatusMsg st{3};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 4, st));
+    usleep(20000);
+    hostTwaiSent();                                     // Ping aus dem ersten Zyklus
+    TEST_ASSERT_EQUAL(ESP_OK, bus.flush());
+    usleep(20000);
+    std::vector<twai_message_t> sent = hostTwaiSent();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL(CANBus::BUNDLE_TYPE_ID, sent[0].identifier & 0x07);
+}
+
+// Coalescing: fehlgeschlagenes Bündel bleibt erhalten und kommt über onError; direkt
+// gesendete Nachrichten (8 Byte, fragmentiert) überholen das Bündel ihrer Adresse nicht
+static void test_bundle_kept_on_error_and_ordered() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    bus.setRetryLimit(0);
+    bus.setCoalescing(true, 1000);
+    int errors = 0;
+    uint8_t errType = 0;
+    bus.onError([&](uint8_t type, uint8_t) { ++errors; errType = type; });
+    PingMsg ping{0x0102};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<PingMsg>(0, 1, ping));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, bus.flush());             // Treiber nicht gestartet
+    TEST_ASSERT_EQUAL(1, errors);
+    TEST_ASSERT_EQUAL(CANBus::BUNDLE_TYPE_ID, errType);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    SampleMsg sample{1.0f, 2.0f};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<SampleMsg>(0, 1, sample));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<PingMsg>(0, 2, ping));
+    BlobMsg blob{};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(0, 2, blob));
+    std::vector<twai_message_t> sent = hostTwaiSent();
+    TEST_ASSERT_EQUAL(6, sent.size());
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 1, CANBus::SINGLE, CANBus::BUNDLE_TYPE_ID), sent[0].identifier);
+    TEST_ASSERT_EQUAL_HEX8(0x02, sent[0].data[1]);             // Ping aus dem ersten Versuch
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 1, CANBus::SINGLE, 2), sent[1].identifier);
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 2, CANBus::SINGLE, CANBus::BUNDLE_TYPE_ID), sent[2].identifier);
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 2, CANBus::START, 0), sent[3].identifier);
+    TEST_ASSERT_EQUAL(1, errors);
+}
+
+// sendFromISR wird auch bei aktivem Coalescing nie gebündelt
+static void test_isr_send_bypasses_coalescing() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setCoalescing(true, 1000));
+    StatusMsg st{4};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 3, st));
+    usleep(20000);                                          // Status liegt im Bündel
+    TEST_ASSERT_EQUAL(0, hostTwaiSent().size());
+    PingMsg ping{0x0506};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.sendFromISR<PingMsg>(0, 3, ping));
+    std::vector<twai_message_t> sent;
+    for (int i = 0; i < 100 && sent.size() < 2; ++i) {
+        usleep(1000);
+        std::vector<twai_message_t> more = hostTwaiSent();
+        sent.insert(sent.end(), more.begin(), more.end());
+    }
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 3, CANBus::SINGLE, CANBus::BUNDLE_TYPE_ID), sent[0].identifier);
+    TEST_ASSERT_EQUAL_HEX32(canId(0, 3, CANBus::SINGLE, 0), sent[1].identifier);
+    TEST_ASSERT_EQUAL(2, sent[1].data_length_code - CANBus::LATENCY_TRAILER);
+    TEST_ASSERT_EQUAL_HEX8(0x06, sent[1].data[0]);
+}
+
+// sendFromISR: nur mit TX-Worker, eigener Ring mit fester Tiefe (voll: ESP_ERR_NO_MEM),
+// weckt den Worker und läuft vor allen bereits eingereihten Task-Nachrichten
+static void test_isr_sends_before_queued_messages() {
+    PingMsg ping{0x0A0B};
+    {
+        CANBus idle(GPIO_NUM_5, GPIO_NUM_4);
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, idle.sendFromISR<PingMsg>(0, 1, ping));
+    }
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(1);                                   // ohne ACK: Worker hängt ~200 ms
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker(16, 5, tskNO_AFFINITY, 4096, 2));
+    BlobMsg blob{};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(0, 2, blob));
+    std::vector<twai_message_t> sent;
+    for (int i = 0; i < 100 && sent.empty(); ++i) {
+        usleep(1000);
+        sent = hostTwaiSent();
+    }
+    TEST_ASSERT_FALSE(sent.empty());                        // Worker wartet jetzt auf das ACK
+    StatusMsg st{7};
+    for (int i = 0; i < 3; ++i) TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 3, st));
+    BaseType_t woken = pdFALSE;
+    for (uint16_t i = 0; i < 2; ++i) {
+        ping.value = i;
+        TEST_ASSERT_EQUAL(ESP_OK, bus.sendFromISR<PingMsg>(1, 4, ping, &woken));
+    }
+    TEST_ASSERT_EQUAL(pdTRUE, woken);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, bus.sendFromISR<PingMsg>(1, 4, ping));
+    for (int i = 0; i < 500; ++i) {
+        usleep(1000);
+        std::vector<twai_message_t> more = hostTwaiSent();
+        sent.insert(sent.end(), more.begin(), more.end());
+        if (sent.size() >= 11) break;
+    }
+    TEST_ASSERT_EQUAL(6 + 2 + 3, sent.size());              // Blob + 1 Retry, 2 ISR, 3 Status
+    for (size_t i = 0; i < 6; ++i) TEST_ASSERT_EQUAL(0, sent[i].identifier & 0x07);
+    for (uint8_t i = 0; i < 2; ++i) {
+        TEST_ASSERT_EQUAL_HEX32(canId(1, 4, CANBus::SINGLE, 0), sent[6 + i].identifier);
+        TEST_ASSERT_EQUAL(i, sent[6 + i].data[0]);
+    }
+    for (size_t i = 8; i < 11; ++i)
+        TEST_ASSERT_EQUAL_HEX32(canId(0, 3, CANBus::SINGLE, 1), sent[i].identifier);
+}
+
+// Replay ohne init(): ACK-Frames aus dem Mitschnitt dürfen keinen Sender wecken
+static void test_replay_ack_without_init() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    uint8_t type = 0;
+    bus.injectFrame(canId(3, 0, CANBus::SINGLE, CANBus::ACK_TYPE_ID), &type, 1, 0);
+    int got = 0;
+    bus.onReceive<PingMsg>([&](const PingMsg&) { ++got; });
+    uint8_t d[2] = {1, 0};
+    bus.injectFrame(canId(0, 0, CANBus::SINGLE, 0), d, 2, 10);
+    TEST_ASSERT_EQUAL(1, got);
+}
+
+// Sendefehler eingereihter Nachrichten kommen über onError und busStats() zurück
+static void test_worker_reports_tx_errors() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    static std::atomic<int> errors{0};
+    static std::atomic<uint8_t> errorType{0xFF};
+    bus.onError([](uint8_t type, uint8_t) { errorType.store(type); ++errors; });
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startTxWorker());
+    hostTwaiSetState(TWAI_STATE_BUS_OFF);
+    StatusMsg st{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 4, st));   // nur eingereiht
+    for (int i = 0; i < 100 && !errors.load(); ++i) usleep(1000);
+    TEST_ASSERT_EQUAL(1, errors.load());
+    TEST_ASSERT_EQUAL(CANBus::MsgType<StatusMsg>::TypeID, errorType.load());
+    TEST_ASSERT_EQUAL(1, bus.busStats().queuedTxFailed);
+    TEST_ASSERT_EQUAL(0, hostTwaiSent().size());
+}
+
+// Ein Bus-Off: Recovery genau nach backoffMs (VirtualClock), danach wieder RUNNING
+static void busOffAndRecover(CANBus& bus, uint32_t backoffMs) {
+    uint32_t recoveries = bus.busStats().recoveries;
+    hostTwaiSetState(TWAI_STATE_BUS_OFF);
+    bus.handleReceive();
+    CANBus::VirtualClock::advance(int64_t(backoffMs - 1) * 1000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(TWAI_STATE_BUS_OFF, bus.busStats().state);
+    CANBus::VirtualClock::advance(1000);
+    bus.handleReceive();                                    // twai_initiate_recovery()
+    bus.handleReceive();                                    // BUS_RECOVERED → twai_start()
+    CANBus::BusStats st = bus.busStats();
+    TEST_ASSERT_EQUAL(TWAI_STATE_RUNNING, st.state);
+    TEST_ASSERT_EQUAL(recoveries + 1, st.recoveries);
+    TEST_ASSERT_EQUAL(backoffMs, st.lastRecoveryMs);
+}
+
+// Auto-Recovery: Backoff verdoppelt sich bei wiederholtem Bus-Off bis zum Maximum und
+// fällt nach stabilem Betrieb (Backoff + Maximum) auf den Startwert zurück
+static void test_bus_off_recovery_backoff() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setClock(&CANBus::VirtualClock::now);
+    bus.setAutoRecovery(true, 10, 40);
+    busOffAndRecover(bus, 10);
+    CANBus::VirtualClock::advance(5000);
+    busOffAndRecover(bus, 20);
+    CANBus::VirtualClock::advance(5000);
+    busOffAndRecover(bus, 40);
+    CANBus::VirtualClock::advance(5000);
+    busOffAndRecover(bus, 40);                              // gedeckelt
+    CANBus::VirtualClock::advance(100000);                  // stabil > 40 + 40 ms
+    busOffAndRecover(bus, 10);
+    TEST_ASSERT_EQUAL(5, bus.busStats().busOff);
+    TEST_ASSERT_EQUAL(40, bus.busStats().maxRecoveryMs);
+
+    // Ohne Auto-Recovery bleibt der Controller im Bus-Off
+    bus.setAutoRecovery(false);
+    hostTwaiSetState(TWAI_STATE_BUS_OFF);
+    bus.handleReceive();
+    CANBus::VirtualClock::advance(2000000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(TWAI_STATE_BUS_OFF, bus.busStats().state);
+    TEST_ASSERT_EQUAL(5, bus.busStats().recoveries);
+}
+
+// Priorität 3 gewinnt die Arbitrierung (kleinster Identifier) und wird zuerst zugestellt
+static void test_priority_matches_arbitration() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    StatusMsg st{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(3, 1, st));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 1, st));
+    std::vector<twai_message_t> sent = hostTwaiSent();
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_LESS_THAN(sent[1].identifier, sent[0].identifier);
+
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setDeferredDelivery(4));
+    std::vector<uint8_t> order;
+    bus.onReceive<StatusMsg>([&](const StatusMsg& m, const CANBus::RxInfo& info) {
+        TEST_ASSERT_EQUAL(m.state, info.prio);
+        order.push_back(info.prio);
+    });
+    for (uint8_t prio = 0; prio < 4; ++prio) {
+        StatusMsg m{prio};
+        bus.injectFrame(canId(prio, 1, CANBus::SINGLE, 1), &m.state, 1, 0);
+    }
+    TEST_ASSERT_EQUAL(4, bus.processReceived());
+    const uint8_t expected[4] = {3, 2, 1, 0};
+    TEST_ASSERT_EQUAL_MEMORY(expected, order.data(), 4);
+
+    CANRta rta;
+    CANRta::Message msg = {"high", 1, 3, 1, 8, 10000, 0, 0, false};
+    rta.add(msg);
+    msg.name = "low";
+    msg.prio = 0;
+    rta.add(msg);
+    CANRta::Report rep = rta.analyze();
+    TEST_ASSERT_LESS_THAN(rep.results[1].minId, rep.results[0].maxId);
+    TEST_ASSERT_LESS_OR_EQUAL(rep.results[1].responseUs, rep.results[0].responseUs);
+}
+
+// Beispiel aus Davis, Burns, Bril, Lukkien (2007): 125 kbit/s, Frames zu
+// 125 Bit (1 ms). C (niedrigste Priorität) verpasst die Deadline erst in der zweiten
+// Instanz der Busy-Period; die ursprüngliche Analyse (nur q = 0) ergab 3,0 ms
+static void test_rta_davis_worked_example() {
+    CANRta rta(125000);
+    rta.add({"A", 1, 3, 1, 7, 2500, 2500, 0, false});
+    rta.add({"B", 2, 2, 1, 7, 3500, 3250, 0, false});
+    rta.add({"C", 3, 1, 1, 7, 3500, 3250, 0, false});
+    CANRta::Report rep = rta.analyze();
+    TEST_ASSERT_EQUAL(3, rep.results.size());
+    TEST_ASSERT_EQUAL(1000, rep.results[0].transmitUs);
+    TEST_ASSERT_EQUAL(2000, rep.results[0].responseUs);
+    TEST_ASSERT_EQUAL(3000, rep.results[1].responseUs);
+    TEST_ASSERT_EQUAL(3500, rep.results[2].responseUs);
+    TEST_ASSERT_TRUE(rep.results[1].schedulable);
+    TEST_ASSERT_FALSE(rep.results[2].schedulable);
+    TEST_ASSERT_FALSE(rep.schedulable);
+}
+
+// Fragmentierte Nachricht: jeder ihrer Frames kann einmal blockiert werden
+static void test_rta_blocking_per_fragment() {
+    CANRta rta(125000);
+    rta.add({"frag", 1, 3, 1, 20, 100000, 0, 0, false});     // 3 Frames: 135 + 135 + 105 Bit
+    rta.add({"low", 2, 0, 1, 8, 100000, 0, 0, false});       // 135 Bit = 1080 µs
+    CANRta::Report rep = rta.analyze();
+    TEST_ASSERT_EQUAL(3, rep.results[0].frames);
+    TEST_ASSERT_EQUAL(3000, rep.results[0].transmitUs);
+    TEST_ASSERT_EQUAL(3000 + 3 * 1080, rep.results[0].responseUs);
+}
+
+// Mailbox unter Dauerlast des Schreibers: Leser kommen durch und sehen nie halbe Werte
+static void test_mailbox_reader_under_writer_load() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    CANBus::Mailbox<SampleMsg> box;
+    bus.attachMailbox(box);
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        for (uint32_t i = 1; !stop.load(); ++i) {
+            float v[2] = {float(i), float(i)};
+            bus.injectFrame(canId(0, 0, CANBus::SINGLE, 2), reinterpret_cast<uint8_t*>(v), 8, i);
+        }
+    });
+    uint32_t reads = 0, torn = 0;
+    int64_t start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < 100000) {
+        SampleMsg m;
+        if (!box.read(m)) continue;
+        ++reads;
+        if (m.temperature != m.humidity) ++torn;
+    }
+    stop = true;
+    writer.join();
+    TEST_ASSERT_GREATER_THAN(1000, reads);
+    TEST_ASSERT_EQUAL(0, torn);
+}
+
+// Reassembly-Timeout (500 ms) in virtueller Zeit über den Treiber-Empfangspfad
+static void test_reassembly_timeout_virtual_clock() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setClock(&CANBus::VirtualClock::now);
+    int got = 0;
+    bus.onReceive<BlobMsg>([&](const BlobMsg&) { ++got; });
+    uint8_t data[20] = {1, 2, 3};
+    std::vector<twai_message_t> f = fragments(0, data, sizeof(data));
+
+    for (const twai_message_t& m : f) hostTwaiInject(m);
+    for (int i = 0; i < 5; ++i) bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, got);
+
+    hostTwaiInject(f[0]);
+    bus.handleReceive();
+    CANBus::VirtualClock::advance(600000);
+    for (size_t i = 1; i < f.size(); ++i) hostTwaiInject(f[i]);
+    for (int i = 0; i < 5; ++i) bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, got);
+}
+
+// Replay einer Capture-Datei in eine CANBus-Instanz (tools/capture_replay.h)
+static void test_capture_replay_into_bus() {
+    char path[] = "/tmp/canbus_native_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+
+    uint8_t data[20];
+    for (uint8_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<uint8_t>(0xA0 + i);
+    std::vector<twai_message_t> f = fragments(0, data, sizeof(data));
+    uint8_t block[CANCapture::BLOCK_SIZE] = {};
+    CANCapture::BlockHeader* h = reinterpret_cast<CANCapture::BlockHeader*>(block);
+    CANCapture::Record* r = reinterpret_cast<CANCapture::Record*>(block + sizeof(CANCapture::BlockHeader));
+    h->magic = CANCapture::BLOCK_MAGIC;
+    h->version = CANCapture::VERSION;
+    h->baseUs = 5000000;
+    const int messages = 10;
+    for (int n = 0; n < messages; ++n) {
+        for (size_t i = 0; i < f.size(); ++i) {
+            CANCapture::Record& rec = r[h->count++];
+            rec.deltaUs = static_cast<uint32_t>(n * 10000 + i * 200);
+            rec.identifier = static_cast<uint16_t>(f[i].identifier);
+            rec.dlc = f[i].data_length_code;
+            memcpy(rec.data, f[i].data, rec.dlc);
+            CANCapture::markId(*h, rec.identifier);
+            h->lastUs = h->baseUs + rec.deltaUs;
+        }
+    }
+    TEST_ASSERT_EQUAL(sizeof(block), write(fd, block, sizeof(block)));
+    close(fd);
+
+    CaptureFile file;
+    TEST_ASSERT_TRUE(file.open(path));
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    int got = 0;
+    bus.onReceive<BlobMsg>([&](const BlobMsg& m) {
+        if (memcmp(m.bytes, data, sizeof(data)) == 0) ++got;
+    });
+    CaptureReplay replay(file);
+    replay.addBus(bus);
+    replay.setSpeed(0);
+    CaptureReplay::Stats s = replay.run();
+    unlink(path);
+    TEST_ASSERT_EQUAL(messages * f.size(), s.frames);
+    TEST_ASSERT_EQUAL(messages, got);
+}
+
+// Master stempelt den eigenen SYNC per Self-Reception; FOLLOW_UP trägt genau diesen
+// Zeitpunkt, auch wenn zwischen SYNC und Echo weitere Frames gesendet werden
+static int64_t slaveClock() { return CANBus::VirtualClock::now() + 250000; }
+
+static void test_time_sync_self_reception() {
+    CANBus master(GPIO_NUM_5, GPIO_NUM_4);
+    CANBus slave(GPIO_NUM_5, GPIO_NUM_4);
+    master.setClock(&CANBus::VirtualClock::now);
+    slave.setClock(&slaveClock);
+    TEST_ASSERT_EQUAL(ESP_OK, master.init());
+    master.setRetryLimit(0);
+    master.setTimeSync(CANBus::SYNC_MASTER, 100);
+    slave.setTimeSync(CANBus::SYNC_SLAVE);
+    int syncs = 0;
+    hostTwaiOnTransmit([&](const twai_message_t& m) {
+        slave.injectFrame(m.identifier, m.data, m.data_length_code, slave.nowUs());
+        if (m.self) {
+            ++syncs;
+            PingMsg ping{7};
+            master.send<PingMsg>(1, 2, ping);           // vor dem Echo in der TX-Queue
+        }
+    });
+    for (int round = 1; round <= 2; ++round) {
+        for (int i = 0; i < 5 && slave.timeSyncStatus().syncs < uint32_t(round); ++i) master.handleReceive();
+        TEST_ASSERT_EQUAL(round, syncs);
+        CANBus::TimeSyncStatus st = slave.timeSyncStatus();
+        TEST_ASSERT_TRUE(st.synced);
+        TEST_ASSERT_EQUAL(round, st.syncs);
+        TEST_ASSERT_EQUAL(0, st.lastErrorUs);
+        TEST_ASSERT_EQUAL(0, st.driftPpb);
+        TEST_ASSERT_EQUAL(CANBus::VirtualClock::now(), slave.busTimeUs());
+        CANBus::VirtualClock::advance(100000);
+    }
+}
+
+// Fault-Stufe: Konfiguration aus einem Task, Senden aus einem anderen (gemeinsamer Mutex)
+static void test_fault_script_concurrent_config() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(0);
+    bus.setFaultScript(CANBus::FAULT_TX, "D.");
+    PingMsg ping{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<PingMsg>(1, 2, ping));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<PingMsg>(1, 2, ping));
+    TEST_ASSERT_EQUAL(1, hostTwaiSent().size());
+    TEST_ASSERT_EQUAL(1, bus.faultStats(CANBus::FAULT_TX).dropped);
+
+    std::atomic<bool> done{false};
+    std::thread config([&]() {
+        while (!done.load()) bus.setFaultScript(CANBus::FAULT_TX, "..");
+    });
+    for (int i = 0; i < 2000; ++i) bus.send<PingMsg>(1, 2, ping);
+    done.store(true);
+    config.join();
+    TEST_ASSERT_EQUAL(2002, bus.faultStats(CANBus::FAULT_TX).frames);
+}
+
+// Mit RX-Task stellt dieser auch von der Fault-Stufe verzögerte Frames zu, nicht der
+// Task, der handleReceive() aufruft
+static void test_delayed_rx_frames_stay_on_rx_task() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    static std::atomic<int> got{0};
+    static std::atomic<bool> onCaller{false};
+    static std::thread::id caller;
+    caller = std::this_thread::get_id();
+    bus.onReceive<PingMsg>([](const PingMsg&) {
+        if (std::this_thread::get_id() == caller) onCaller.store(true);
+        ++got;
+    });
+    bus.setFaultScript(CANBus::FAULT_RX, "L", 20);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startRxTask());
+    uint8_t d[2] = {1, 0};
+    hostTwaiInject(hostTwaiFrame(canId(0, 0, CANBus::SINGLE, 0), d, 2));
+    int64_t start = esp_timer_get_time();
+    while (!got.load() && esp_timer_get_time() - start < 1000000) bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, got.load());
+    TEST_ASSERT_FALSE(onCaller.load());
+    TEST_ASSERT_EQUAL(1, bus.faultStats(CANBus::FAULT_RX).delayed);
+    bus.stopRxTask();
+    while (bus.rxTaskRunning()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+// Drei Nachrichten in eine Queue mit zwei Slots; zugestellte Werte in Reihenfolge
+static void overflowRun(CANBus& bus, CANBus::Backpressure policy, bool viaDriver,
+                        std::vector<uint8_t>& got) {
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setDeferredDelivery(2, policy));
+    bus.onReceive<StatusMsg>([&got](const StatusMsg& m) { got.push_back(m.state); });
+    for (uint8_t v = 1; v <= 3; ++v) {
+        if (viaDriver) hostTwaiInject(hostTwaiFrame(canId(1, 0, CANBus::SINGLE, 1), &v, 1));
+        else bus.injectFrame(canId(1, 0, CANBus::SINGLE, 1), &v, 1, 0);
+    }
+    if (viaDriver)
+        for (int i = 0; i < 3; ++i) bus.handleReceive();
+    bus.processReceived();
+}
+
+// Überlauf der Übergabe-Queue je Policy; BLOCK im selben Task wartet nicht
+static void test_deferred_overflow_policies() {
+    {
+        CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+        std::vector<uint8_t> got;
+        overflowRun(bus, CANBus::DROP_OLDEST, false, got);
+        const uint8_t expected[2] = {2, 3};
+        TEST_ASSERT_EQUAL(2, got.size());
+        TEST_ASSERT_EQUAL_MEMORY(expected, got.data(), 2);
+        TEST_ASSERT_EQUAL(1, bus.droppedReceived());
+    }
+    {
+        CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+        std::vector<uint8_t> got;
+        overflowRun(bus, CANBus::DROP_NEWEST, false, got);
+        const uint8_t expected[2] = {1, 2};
+        TEST_ASSERT_EQUAL(2, got.size());
+        TEST_ASSERT_EQUAL_MEMORY(expected, got.data(), 2);
+        TEST_ASSERT_EQUAL(1, bus.droppedReceived());
+    }
+    {
+        CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+        TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+        int64_t start = esp_timer_get_time();
+        std::vector<uint8_t> got;
+        overflowRun(bus, CANBus::BLOCK, true, got);
+        TEST_ASSERT_LESS_THAN(50000, esp_timer_get_time() - start);
+        const uint8_t expected[2] = {1, 2};
+        TEST_ASSERT_EQUAL(2, got.size());
+        TEST_ASSERT_EQUAL_MEMORY(expected, got.data(), 2);
+        TEST_ASSERT_EQUAL(1, bus.droppedReceived());
+    }
+}
+
+// BLOCK mit RX-Task: wartet auf den Konsumenten, nach CANBUS_RX_BLOCK_MS verworfen
+static void test_deferred_block_with_rx_task() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setDeferredDelivery(2, CANBus::BLOCK));
+    static std::atomic<int> got{0};
+    bus.onReceive<StatusMsg>([](const StatusMsg&) { ++got; });
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startRxTask());
+    for (uint8_t v = 1; v <= 3; ++v) hostTwaiInject(hostTwaiFrame(canId(1, 0, CANBus::SINGLE, 1), &v, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));     // RX-Task wartet auf Slot
+    int64_t start = esp_timer_get_time();
+    while (got.load() < 3 && esp_timer_get_time() - start < 1000000) bus.processReceived();
+    TEST_ASSERT_EQUAL(3, got.load());
+    TEST_ASSERT_EQUAL(0, bus.droppedReceived());
+
+    for (uint8_t v = 1; v <= 3; ++v) hostTwaiInject(hostTwaiFrame(canId(1, 0, CANBus::SINGLE, 1), &v, 1));
+    start = esp_timer_get_time();
+    while (!bus.droppedReceived() && esp_timer_get_time() - start < 1000000)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    TEST_ASSERT_EQUAL(1, bus.droppedReceived());
+    TEST_ASSERT_GREATER_OR_EQUAL(CANBUS_RX_BLOCK_MS * 1000 - 5000, esp_timer_get_time() - start);
+    bus.stopRxTask();
+    while (bus.rxTaskRunning()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+// Baudrate aus dem Konstruktor bestimmt das Bit-Timing; nicht unterstützte → init() schlägt fehl
+static void test_baud_selects_timing() {
+    CANBus fast(GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_LISTEN_ONLY, 1000000);
+    TEST_ASSERT_EQUAL(1000000, fast.bitrate());
+    TEST_ASSERT_EQUAL(ESP_OK, fast.init());
+    twai_timing_config_t want = TWAI_TIMING_CONFIG_1MBITS();
+    TEST_ASSERT_EQUAL(want.brp, hostTwaiTiming().brp);
+    TEST_ASSERT_EQUAL(want.tseg_1, hostTwaiTiming().tseg_1);
+    TEST_ASSERT_EQUAL(want.tseg_2, hostTwaiTiming().tseg_2);
+    hostTwaiReset();
+    CANBus odd(GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_NORMAL, 333000);
+    TEST_ASSERT_EQUAL(0, odd.bitrate());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, odd.init());
+}
+
+// Zweiter Mitschnitt erst, wenn die Tasks des ersten beendet sind
+static void test_capture_start_while_capturing() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_LISTEN_ONLY, 1000000);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    CANBus::CaptureSink sink = [](const uint8_t*, size_t) { return ESP_OK; };
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startCapture(sink));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, bus.startCapture(sink));
+    bus.stopCapture();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, bus.startCapture(sink));    // Tasks laufen noch aus
+    for (int i = 0; i < 100 && bus.capturing(); ++i) vTaskDelay(pdMS_TO_TICKS(10));
+    TEST_ASSERT_FALSE(bus.capturing());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startCapture(sink));
+    bus.stopCapture();
+    for (int i = 0; i < 100 && bus.capturing(); ++i) vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+// Volllast bei 1 Mbit/s: kürzeste Frames (DLC 0, 47 Bit) ~21300/s, Senke mit 2 ms je
+// Block (Flash-Schreiblatenz). Jeder Frame muss im Mitschnitt landen, in Reihenfolge.
+static void test_capture_full_load_without_drops() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_LISTEN_ONLY, 1000000);
+    bus.setQueueLength(0, 1024);        // ~48 ms Puffer gegen Scheduler-Jitter des Hosts
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    static std::vector<uint16_t> ids;
+    ids.clear();
+    CANBus::CaptureSink sink = [](const uint8_t* block, size_t) {
+        const CANCapture::BlockHeader* h = reinterpret_cast<const CANCapture::BlockHeader*>(block);
+        if (h->magic != CANCapture::BLOCK_MAGIC) return ESP_OK;         // Indexblock
+        const CANCapture::Record* r = reinterpret_cast<const CANCapture::Record*>(block + sizeof(*h));
+        for (uint16_t i = 0; i < h->count; ++i) ids.push_back(r[i].identifier);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return ESP_OK;
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startCapture(sink, 4));
+
+    const uint32_t framesPerSec = 1000000 / 47;
+    uint32_t injected = 0;
+    int64_t start = esp_timer_get_time();
+    for (int64_t t = 0; t < 500000; t = esp_timer_get_time() - start) {
+        for (uint32_t due = uint32_t(t * framesPerSec / 1000000); injected < due; ++injected)
+            hostTwaiInject(hostTwaiFrame(injected & 0x7FF, nullptr, 0));
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bus.stopCapture();
+    for (int i = 0; i < 100 && bus.capturing(); ++i) vTaskDelay(pdMS_TO_TICKS(10));
+    TEST_ASSERT_FALSE(bus.capturing());
+
+    twai_status_info_t st;
+    TEST_ASSERT_EQUAL(ESP_OK, twai_get_status_info(&st));
+    TEST_ASSERT_EQUAL(0, st.rx_missed_count);
+    CANBus::CaptureStats stats = bus.captureStats();
+    TEST_ASSERT_EQUAL(0, stats.droppedFrames);
+    TEST_ASSERT_EQUAL(0, stats.sinkErrors);
+    TEST_ASSERT_EQUAL(injected, stats.frames);
+    TEST_ASSERT_EQUAL(injected, ids.size());
+    uint32_t outOfOrder = 0;
+    for (uint32_t i = 0; i < ids.size(); ++i) outOfOrder += ids[i] != (i & 0x7FF);
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+}
+
+// Ein Mitschnitt von frames Frames über den Capture-Pfad, angehängt an out
+static void captureSession(CANBus& bus, uint32_t frames, std::vector<uint8_t>& out) {
+    static std::vector<uint8_t>* file;
+    file = &out;
+    CANBus::CaptureSink sink = [](const uint8_t* block, size_t len) {
+        file->insert(file->end(), block, block + len);
+        return ESP_OK;
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, bus.startCapture(sink, 4));
+    // Treiber-Queue nicht überlaufen lassen und höchstens zwei Blöcke in den Puffern
+    // (langsamer Writer unter Last), damit nichts verworfen wird
+    const uint32_t inFlight = 2 * CANCapture::RECORDS_PER_BLOCK;
+    for (uint32_t i = 0; i < frames; ++i) {
+        twai_status_info_t st;
+        while ((twai_get_status_info(&st) == ESP_OK && st.msgs_to_rx > 200) ||
+               i - bus.captureStats().blocks * CANCapture::RECORDS_PER_BLOCK > inFlight)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        hostTwaiInject(hostTwaiFrame(i & 0x7FF, nullptr, 0));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bus.stopCapture();
+    for (int i = 0; i < 100 && bus.capturing(); ++i) vTaskDelay(pdMS_TO_TICKS(10));
+    TEST_ASSERT_FALSE(bus.capturing());
+    TEST_ASSERT_EQUAL(frames, bus.captureStats().frames);
+}
+
+// Zwei angehängte Sitzungen (die zweite nach "Neustart" mit kleineren Zeitstempeln):
+// open() liest nur Trailer und Indexblöcke, Abfragen laufen je Sitzung; ohne Trailer
+// bleibt der Weg über alle Header mit demselben Ergebnis
+static void test_capture_index_and_appended_sessions() {
+    PERSISTENT_BUS(bus, GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_LISTEN_ONLY, 1000000);
+    bus.setQueueLength(0, 256);
+    bus.setClock(&CANBus::VirtualClock::now);
+    CANBus::VirtualClock::setStep(1);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    std::vector<uint8_t> data;
+    const uint32_t first = uint32_t(CANCapture::INDEX_ENTRIES + 20) * CANCapture::RECORDS_PER_BLOCK;
+    CANBus::VirtualClock::set(1000000000);
+    captureSession(bus, first, data);
+    CANBus::VirtualClock::set(1000);
+    captureSession(bus, 500, data);
+    CANBus::VirtualClock::setStep(0);
+    const size_t blocks1 = (first + CANCapture::RECORDS_PER_BLOCK - 1) / CANCapture::RECORDS_PER_BLOCK;
+    const size_t blocks2 = (500 + CANCapture::RECORDS_PER_BLOCK - 1) / CANCapture::RECORDS_PER_BLOCK;
+    TEST_ASSERT_EQUAL((blocks1 + 2 + blocks2 + 1) * CANCapture::BLOCK_SIZE, data.size());   // + Index, Trailer
+
+    char path[] = "/tmp/canbus_native_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        // Durchgang 2: ohne den Trailer der zweiten Sitzung (Abbruch)
+        size_t len = pass ? data.size() - CANCapture::BLOCK_SIZE : data.size();
+        TEST_ASSERT_EQUAL(0, ftruncate(fd, 0));
+        TEST_ASSERT_EQUAL(len, pwrite(fd, data.data(), len, 0));
+        CaptureFile file;
+        TEST_ASSERT_TRUE(file.open(path));
+        TEST_ASSERT_EQUAL(pass == 0, file.indexed());
+        TEST_ASSERT_EQUAL(2, file.sessionCount());
+        TEST_ASSERT_EQUAL(blocks1 + blocks2, file.blockCount());
+        TEST_ASSERT_EQUAL(blocks1, file.session(0).last - file.session(0).first);
+        std::vector<uint16_t> all;
+        TEST_ASSERT_EQUAL(first + 500, file.query(INT64_MIN, INT64_MAX, all, [](const CaptureFile::Frame&) {}));
+        // Zeitbereich der zweiten Sitzung liegt vor der ersten
+        uint32_t seen = 0, wrong = 0;
+        file.query(0, 100000000, all, [&](const CaptureFile::Frame& f) {
+            wrong += f.rec->identifier != (seen++ & 0x7FF);
+        });
+        TEST_ASSERT_EQUAL(500, seen);
+        TEST_ASSERT_EQUAL(0, wrong);
+        std::vector<uint16_t> one(1, 0x123);
+        TEST_ASSERT_EQUAL(first / 2048 + (first % 2048 > 0x123) + 1,
+                          file.query(INT64_MIN, INT64_MAX, one, [](const CaptureFile::Frame&) {}));
+    }
+    close(fd);
+    unlink(path);
+}
+
+// TT auf der virtuellen Uhr: Zyklus 10 ms, exklusives Fenster [0, 2) ms für Knoten 1,
+// Arbitrierung [2, 10) ms
+static std::vector<CANBus::TxWindow> ttWindows() {
+    return {{0, 2000, CANBus::WINDOW_EXCLUSIVE, 1}, {2000, 8000, CANBus::WINDOW_ARBITRATION, 0}};
+}
+
+static void test_tt_exclusive_and_arbitration_windows() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    bus.setClock(&CANBus::VirtualClock::now);
+    bus.setNodeAddress(1);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(0);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setTimeTriggered(10000, ttWindows()));
+    static PingMsg ping{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.scheduleInWindow<PingMsg>(0, 2, ping, 0));
+    std::vector<std::pair<uint8_t, int64_t>> sent;      // Type-ID, Sendezeit
+    hostTwaiOnTransmit([&](const twai_message_t& m) {
+        sent.push_back(std::make_pair(uint8_t(m.identifier & 0x07), CANBus::VirtualClock::now()));
+    });
+
+    // Beginn des exklusiven Fensters: TT-Nachricht sofort
+    CANBus::VirtualClock::set(1000000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL(1000000, sent[0].second);
+    TEST_ASSERT_EQUAL(1, bus.timeTriggeredStats().sent);
+
+    // send() im exklusiven Fenster wartet auf das Arbitrierungsfenster
+    CANBus::VirtualClock::setStep(100);
+    CANBus::VirtualClock::set(1000500);
+    StatusMsg st{2};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 4, st));
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL(CANBus::MsgType<StatusMsg>::TypeID, sent[1].first);
+    TEST_ASSERT_TRUE(sent[1].second >= 1002000 && sent[1].second < 1003000);
+    TEST_ASSERT_EQUAL(1, bus.timeTriggeredStats().deferred);
+
+    // Frame passt nicht mehr ins Arbitrierungsfenster: über das exklusive Fenster des
+    // nächsten Zyklus hinweg warten, dort läuft die TT-Nachricht
+    CANBus::VirtualClock::set(1009950);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 4, st));
+    TEST_ASSERT_EQUAL(4, sent.size());
+    TEST_ASSERT_EQUAL(CANBus::MsgType<PingMsg>::TypeID, sent[2].first);
+    TEST_ASSERT_TRUE(sent[2].second >= 1010000 && sent[2].second < 1011000);
+    TEST_ASSERT_EQUAL(CANBus::MsgType<StatusMsg>::TypeID, sent[3].first);
+    TEST_ASSERT_TRUE(sent[3].second >= 1012000 && sent[3].second < 1013000);
+    TEST_ASSERT_EQUAL(2, bus.timeTriggeredStats().sent);
+    TEST_ASSERT_EQUAL(2, bus.timeTriggeredStats().deferred);
+}
+
+// Verpasste Fenster: drei übersprungene Zyklen plus das aktuelle, zu spät begonnene
+static void test_tt_missed_windows() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    bus.setClock(&CANBus::VirtualClock::now);
+    bus.setNodeAddress(1);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    TEST_ASSERT_EQUAL(ESP_OK, bus.setTimeTriggered(10000, ttWindows()));
+    static PingMsg ping{1};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.scheduleInWindow<PingMsg>(0, 2, ping, 0));
+    CANBus::VirtualClock::set(1010000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, bus.timeTriggeredStats().sent);
+    CANBus::VirtualClock::set(1051900);                 // nach dem spätesten Start (1850 µs)
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, bus.timeTriggeredStats().sent);
+    TEST_ASSERT_EQUAL(4, bus.timeTriggeredStats().missed);
+    CANBus::VirtualClock::set(1055000);
+    bus.handleReceive();
+    TEST_ASSERT_EQUAL(4, bus.timeTriggeredStats().missed);
+
+    CANBus odd(GPIO_NUM_5, GPIO_NUM_4, TWAI_MODE_NORMAL, 333000);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, odd.setTimeTriggered(10000, ttWindows()));
+}
+
+// Servo mit bekannter Gangabweichung: Slave-Uhr 100 ppm zu langsam, Master-Neustart
+// (Zeitsprung um 3 h) setzt den Servo zurück statt die Drift zu verfälschen
+static int64_t g_masterJumpUs = 0;
+static int64_t skewMasterClock() { return CANBus::VirtualClock::now() + g_masterJumpUs; }
+static int64_t skewSlaveClock() {
+    int64_t t = CANBus::VirtualClock::now();
+    return 777000 + t - t / 10000;
+}
+
+static void test_time_sync_servo_drift_and_reset() {
+    g_masterJumpUs = 0;
+    CANBus master(GPIO_NUM_5, GPIO_NUM_4);
+    CANBus slave(GPIO_NUM_5, GPIO_NUM_4);
+    master.setClock(&skewMasterClock);
+    slave.setClock(&skewSlaveClock);
+    TEST_ASSERT_EQUAL(ESP_OK, master.init());
+    master.setRetryLimit(0);
+    master.setTimeSync(CANBus::SYNC_MASTER, 1000);
+    slave.setTimeSync(CANBus::SYNC_SLAVE);
+    hostTwaiOnTransmit([&](const twai_message_t& m) {
+        slave.injectFrame(m.identifier, m.data, m.data_length_code, slave.nowUs());
+    });
+    auto syncOnce = [&]() {
+        uint32_t before = slave.timeSyncStatus().syncs;
+        for (int i = 0; i < 5 && slave.timeSyncStatus().syncs == before; ++i) master.handleReceive();
+        TEST_ASSERT_EQUAL(before + 1, slave.timeSyncStatus().syncs);
+    };
+    for (int round = 0; round < 5; ++round) {
+        syncOnce();
+        CANBus::VirtualClock::advance(1000000);
+    }
+    CANBus::TimeSyncStatus st = slave.timeSyncStatus();
+    TEST_ASSERT_INT_WITHIN(50, 100010, st.driftPpb);
+    TEST_ASSERT_INT_WITHIN(2, 0, st.lastErrorUs);
+    TEST_ASSERT_EQUAL(0, st.resets);
+    // Vorhersage 1 s nach dem letzten Sync
+    TEST_ASSERT_INT_WITHIN(2, skewMasterClock(), slave.busTimeUs());
+
+    g_masterJumpUs = 3LL * 3600 * 1000000;
+    master.setTimeSync(CANBus::SYNC_MASTER, 1000);      // Master neu gestartet
+    syncOnce();
+    st = slave.timeSyncStatus();
+    TEST_ASSERT_EQUAL(1, st.resets);
+    TEST_ASSERT_TRUE(st.lastErrorUs > 3LL * 3600 * 1000000 - 1000);
+    TEST_ASSERT_EQUAL(0, st.driftPpb);
+    TEST_ASSERT_EQUAL(skewMasterClock(), slave.busTimeUs());
+    CANBus::VirtualClock::advance(1000000);
+    syncOnce();
+    TEST_ASSERT_INT_WITHIN(50, 100010, slave.timeSyncStatus().driftPpb);
+}
+
+// Histogram: Klassen mit 4 Stufen je Zweierpotenz (max. 25 % Fehler), Quantile liefern
+// die Untergrenze der Klasse, nie weniger als min()
+static void test_histogram_buckets_and_percentiles() {
+    for (uint32_t v = 0; v < 100000; v = v * 9 / 8 + 1) {
+        uint32_t lo = CANBus::Histogram::lowerBound(CANBus::Histogram::bucket(v));
+        TEST_ASSERT_TRUE(lo <= v);
+        TEST_ASSERT_TRUE(v - lo <= v / 4);
+    }
+    TEST_ASSERT_TRUE(CANBus::Histogram::bucket(UINT32_MAX) < CANBus::Histogram::BUCKETS);
+    static CANBus::Histogram h;
+    h.reset();
+    TEST_ASSERT_EQUAL(0, h.percentile(0.5f));
+    for (uint32_t v = 1; v <= 100; ++v) h.record(v);
+    TEST_ASSERT_EQUAL(100, h.count());
+    TEST_ASSERT_EQUAL(1, h.min());
+    TEST_ASSERT_EQUAL(100, h.max());
+    TEST_ASSERT_EQUAL(5050, h.sum());
+    TEST_ASSERT_EQUAL(48, h.percentile(0.5f));             // 51 liegt in [48, 56)
+    TEST_ASSERT_EQUAL(80, h.percentile(0.9f));             // 91 liegt in [80, 96)
+    TEST_ASSERT_EQUAL(96, h.percentile(0.99f));            // 100 liegt in [96, 112)
+    h.reset();
+    TEST_ASSERT_EQUAL(0, h.count());
+    TEST_ASSERT_EQUAL(0, h.min());
+}
+
+#if CANBUS_PROFILING
+// Profiling: jede Stufe zählt genau ihre Durchläufe, dumpProfile() eine Zeile je Stufe
+static void test_profile_stage_counts() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(0);
+    int got = 0;
+    bus.onReceive<BlobMsg>([&](const BlobMsg&) { ++got; });
+    bus.onReceive<StatusMsg>([&](const StatusMsg&) { ++got; });
+    BlobMsg blob{};
+    StatusMsg st{2};
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<BlobMsg>(0, 1, blob));           // 3 Frames, 1 CRC
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 1, st));
+    std::vector<twai_message_t> sent = hostTwaiSent();
+    TEST_ASSERT_EQUAL(4, sent.size());
+    for (const twai_message_t& m : sent) bus.injectFrame(m.identifier, m.data, m.data_length_code, 0);
+    TEST_ASSERT_EQUAL(2, got);
+    TEST_ASSERT_EQUAL(4, bus.profile(CANBus::PROF_TX).count());
+    TEST_ASSERT_EQUAL(1, bus.profile(CANBus::PROF_CRC).count());
+    TEST_ASSERT_EQUAL(4, bus.profile(CANBus::PROF_RX).count());
+    TEST_ASSERT_EQUAL(3, bus.profile(CANBus::PROF_REASSEMBLY).count());
+    TEST_ASSERT_EQUAL(2, bus.profile(CANBus::PROF_DISPATCH).count());
+    TEST_ASSERT_TRUE(bus.profile(CANBus::PROF_RX).max() >= bus.profile(CANBus::PROF_DISPATCH).min());
+
+    std::string out;
+    TEST_ASSERT_EQUAL(CANBus::PROF_STAGES, bus.dumpProfile([&](const uint8_t* p, size_t len) {
+        out.append(reinterpret_cast<const char*>(p), len);
+    }));
+    static const char* const stages[] = {"tx", "rx", "reassembly", "crc", "dispatch"};
+    static const unsigned counts[] = {4, 4, 3, 1, 2};
+    size_t pos = out.find('\n');
+    TEST_ASSERT_EQUAL_STRING("stage count min p50 p90 p99 max avg", out.substr(0, pos).c_str());
+    for (int i = 0; i < CANBus::PROF_STAGES; ++i) {
+        char name[16];
+        unsigned count = 0, mn = 0, p50 = 0, p90 = 0, p99 = 0, mx = 0, avg = 0;
+        TEST_ASSERT_EQUAL(8, sscanf(out.c_str() + pos + 1, "%15s %u %u %u %u %u %u %u", name,
+                                    &count, &mn, &p50, &p90, &p99, &mx, &avg));
+        TEST_ASSERT_EQUAL_STRING(stages[i], name);
+        TEST_ASSERT_EQUAL(counts[i], count);
+        TEST_ASSERT_TRUE(mn <= p50 && p50 <= p90 && p90 <= p99 && p99 <= mx);
+        TEST_ASSERT_TRUE(mn <= avg && avg <= mx);
+        pos = out.find('\n', pos + 1);
+    }
+    TEST_ASSERT_EQUAL(out.size() - 1, pos);
+    bus.resetProfile();
+    TEST_ASSERT_EQUAL(0, bus.profile(CANBus::PROF_TX).count());
+}
+#endif
+
+// Frame-Trace: Export byte-genau gegen candump-Log und pcap (LINKTYPE_CAN_SOCKETCAN);
+// ohne CANBUS_TRACE_SIZE (Default 0) bleiben beide leer
+static void test_trace_export_golden() {
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    uint8_t d1[2] = {0xDE, 0xAD};
+    uint8_t d3[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    bus.injectFrame(0x123, d1, 2, 1234567);
+    bus.injectFrame(0x7FE, d1, 0, 2000000);
+    bus.injectFrame(0x0A5, d3, 8, 3000015);
+    std::string log;
+    size_t n = bus.exportCandump([&](const uint8_t* p, size_t len) {
+        log.append(reinterpret_cast<const char*>(p), len);
+    }, "vcan1");
+    std::vector<uint8_t> pcap;
+    size_t m = bus.exportPcap([&](const uint8_t* p, size_t len) { pcap.insert(pcap.end(), p, p + len); });
+    static const uint8_t header[24] = {
+        0xD4, 0xC3, 0xB2, 0xA1, 0x02, 0x00, 0x04, 0x00, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x10, 0x00, 0x00, 0x00, 0xE3, 0x00, 0x00, 0x00};
+#if CANBUS_TRACE_SIZE > 0
+    static_assert(sizeof(CANBus::TraceEntry) == 24, "RAM-Angabe zu CANBUS_TRACE_SIZE");
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL_STRING("(1.234567) vcan1 123#DEAD\n"
+                             "(2.000000) vcan1 7FE#\n"
+                             "(3.000015) vcan1 0A5#0102030405060708\n", log.c_str());
+    static const uint8_t records[3 * 32] = {
+        0x01, 0, 0, 0, 0x47, 0x94, 0x03, 0, 0x10, 0, 0, 0, 0x10, 0, 0, 0,
+        0x00, 0x00, 0x01, 0x23, 2, 0, 0, 0, 0xDE, 0xAD, 0, 0, 0, 0, 0, 0,
+        0x02, 0, 0, 0, 0x00, 0x00, 0x00, 0, 0x10, 0, 0, 0, 0x10, 0, 0, 0,
+        0x00, 0x00, 0x07, 0xFE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x03, 0, 0, 0, 0x0F, 0x00, 0x00, 0, 0x10, 0, 0, 0, 0x10, 0, 0, 0,
+        0x00, 0x00, 0x00, 0xA5, 8, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+    TEST_ASSERT_EQUAL(3, m);
+    TEST_ASSERT_EQUAL(sizeof(header) + sizeof(records), pcap.size());
+    TEST_ASSERT_EQUAL_MEMORY(header, pcap.data(), sizeof(header));
+    TEST_ASSERT_EQUAL_MEMORY(records, pcap.data() + sizeof(header), sizeof(records));
+#else
+    TEST_ASSERT_EQUAL(0, n);
+    TEST_ASSERT_EQUAL(0, log.size());
+    TEST_ASSERT_EQUAL(0, m);
+    TEST_ASSERT_EQUAL(sizeof(header), pcap.size());
+    TEST_ASSERT_EQUAL_MEMORY(header, pcap.data(), sizeof(header));
+#endif
+}
+
+#if CANBUS_LATENCY_TRACE
+DEFINE_CAN_MESSAGE(SixMsg, 3, uint8_t bytes[6];);
+DEFINE_CAN_MESSAGE(WideMsg, 4, uint8_t bytes[23];);
+
+// Latenz-Trailer nur ohne zusätzlichen Frame: 6..8-Byte-Nachrichten bleiben Einzelframes
+// ohne ACK, gehen ungestempelt und werden beim Empfänger gezählt statt gemessen
+static void test_latency_trailer_keeps_frame_count() {
+    static_assert(CANBus::TxLayout<StatusMsg>::len == 4, "1 Byte + Trailer");
+    static_assert(CANBus::TxLayout<SixMsg>::len == 6 && CANBus::TxLayout<SixMsg>::single, "");
+    static_assert(CANBus::TxLayout<SampleMsg>::len == 8, "");
+    static_assert(CANBus::TxLayout<BlobMsg>::len == 23, "20 + 3 + CRC: weiterhin 3 Frames");
+    static_assert(CANBus::TxLayout<WideMsg>::len == 23, "23 + 3 + CRC wären 4 Frames");
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    TEST_ASSERT_EQUAL(ESP_OK, bus.init());
+    bus.setRetryLimit(3);                                   // kein ACK-Partner
+    hostTwaiSetLoopback(true);
+    int samples = 0, statuses = 0;
+    bus.onReceive<SampleMsg>([&](const SampleMsg&) { ++samples; });
+    bus.onReceive<StatusMsg>([&](const StatusMsg&) { ++statuses; });
+    SampleMsg sample{1.0f, 2.0f};
+    StatusMsg st{1};
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<SampleMsg>(0, 1, sample));
+    TEST_ASSERT_EQUAL(ESP_OK, bus.send<StatusMsg>(0, 1, st));
+    TEST_ASSERT_LESS_THAN(50000, esp_timer_get_time() - start);    // kein Warten auf ACK
+    std::vector<twai_message_t> sent = hostTwaiSent();
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL(CANBus::SINGLE, (sent[0].identifier >> 3) & 0x03);
+    TEST_ASSERT_EQUAL(8, sent[0].data_length_code);
+    TEST_ASSERT_EQUAL(4, sent[1].data_length_code);
+    for (int i = 0; i < 5 && samples + statuses < 2; ++i) bus.handleReceive();
+    TEST_ASSERT_EQUAL(1, samples);
+    TEST_ASSERT_EQUAL(1, statuses);
+    TEST_ASSERT_EQUAL(1, bus.latencyUnstamped(2));
+    TEST_ASSERT_EQUAL(0, bus.latencyByType(2).count());
+    TEST_ASSERT_EQUAL(0, bus.latencyUnstamped(1));
+    TEST_ASSERT_EQUAL(1, bus.latencyByType(1).count());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, bus.sendFromISR<SampleMsg>(0, 1, sample));  // ohne Worker
+}
+#endif
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_inject_single_frame);
+    RUN_TEST(test_loopback_fragmented_roundtrip);
+    RUN_TEST(test_dispatch_by_type_id);
+    RUN_TEST(test_publish_policy_per_type);
+    RUN_TEST(test_publish_from_multiple_tasks);
+    RUN_TEST(test_bundle_types_and_deadline);
+    RUN_TEST(test_schedule_aligns_after_long_uptime);
+    RUN_TEST(test_wait_ack_receives_inline);
+    RUN_TEST(test_worker_waits_for_ack_without_spinning);
+    RUN_TEST(test_worker_owns_schedule_and_bundles);
+    RUN_TEST(test_bundle_kept_on_error_and_ordered);
+    RUN_TEST(test_isr_send_bypasses_coalescing);
+    RUN_TEST(test_isr_sends_before_queued_messages);
+    RUN_TEST(test_replay_ack_without_init);
+    RUN_TEST(test_worker_reports_tx_errors);
+    RUN_TEST(test_bus_off_recovery_backoff);
+    RUN_TEST(test_priority_matches_arbitration);
+    RUN_TEST(test_rta_davis_worked_example);
+    RUN_TEST(test_rta_blocking_per_fragment);
+    RUN_TEST(test_mailbox_reader_under_writer_load);
+    RUN_TEST(test_reassembly_timeout_virtual_clock);
+    RUN_TEST(test_capture_replay_into_bus);
+    RUN_TEST(test_time_sync_self_reception);
+    RUN_TEST(test_fault_script_concurrent_config);
+    RUN_TEST(test_delayed_rx_frames_stay_on_rx_task);
+    RUN_TEST(test_deferred_overflow_policies);
+    RUN_TEST(test_deferred_block_with_rx_task);
+    RUN_TEST(test_baud_selects_timing);
+    RUN_TEST(test_capture_start_while_capturing);
+    RUN_TEST(test_capture_full_load_without_drops);
+    RUN_TEST(test_capture_index_and_appended_sessions);
+    RUN_TEST(test_tt_exclusive_and_arbitration_windows);
+    RUN_TEST(test_tt_missed_windows);
+    RUN_TEST(test_time_sync_servo_drift_and_reset);
+    RUN_TEST(test_histogram_buckets_and_percentiles);
+#if CANBUS_PROFILING
+    RUN_TEST(test_profile_stage_counts);
+#endif
+    RUN_TEST(test_trace_export_golden);
+#if CANBUS_LATENCY_TRACE
+    RUN_TEST(test_latency_trailer_keeps_frame_count);
+#endif
+    return UNITY_END();
+}
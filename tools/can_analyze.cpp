@@ -0,0 +1,245 @@
+/**
+can_analyze – Capture-Datei parallel auswerten
+==============================================
+Setzt fragmentierte Nachrichten mit derselben Logik wie CANBus::handleReceive
+(CANReassembler) zusammen, prüft die CRC8 und berichtet je Type-ID:
+Nachrichten, Rate, Nutzbytes, CRC-Fehler, verfallene/verwaiste Fragmente, wegen der
+Reassembly-Grenzen verworfene Frames (limit; Grenzen wie setReassemblyLimits der Firmware),
+Wiederholungen (gleiche Nachricht erneut innerhalb RETRANSMIT_WINDOW_US, ohne dass
+dazwischen ein ACK kam), Übertragungsdauer START→END und Latenz END→ACK (ACK innerhalb
+RETRANSMIT_WINDOW_US).
+
+Verfallen zählt jede Nachricht, deren END nicht innerhalb REASSEMBLY_TIMEOUT nach START
+kommt, auch wenn danach kein Fragment mehr folgt: vor jedem Frame werden die zu diesem
+Zeitpunkt abgelaufenen Kontexte verworfen. Spätere Fragmente sind verwaist.
+
+Parallelisierung: Die Blöcke werden in zusammenhängende Bereiche je Thread geteilt.
+Jeder Thread spielt vorher die Frames ab WARMUP_US vor dem letzten Frame vor seinem
+Bereich ein, ohne sie zu zählen. Offene Kontexte sind dort höchstens REASSEMBLY_TIMEOUT
+alt; eine Nachricht, deren END im Wiederholungsfenster liegt, hat ihr START höchstens
+REASSEMBLY_TIMEOUT davor. Damit ist der Zustand an der Bereichsgrenze identisch zum
+sequenziellen Durchlauf und das Ergebnis unabhängig von --threads.
+
+Die Auswertung erfolgt je Type-ID; Strukturnamen aus DEFINE_CAN_MESSAGE sind
+nur in der Firmware bekannt.
+
+Build (Linux/macOS):
+  g++ -std=c++11 -O2 -pthread -Ilib/esp32_can_library -Itools tools/can_analyze.cpp -o can_analyze
+
+Aufruf:
+  can_analyze DATEI [--threads N] [--max-bytes N] [--max-frames N] [--max-contexts N]
+  (Default der Grenzen wie CANReassembler::Limits: 1024 Byte, 160 Frames, 32 Kontexte) */
+#include "capture_file.h"
+#include "can_reassembly.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+static constexpr int64_t REASSEMBLY_TIMEOUT_US = 500000;   // wie CANBus::REASSEMBLY_TIMEOUT
+static constexpr int64_t RETRANSMIT_WINDOW_US  = 1000000;
+static constexpr int64_t WARMUP_US = RETRANSMIT_WINDOW_US + REASSEMBLY_TIMEOUT_US;
+static constexpr uint8_t ACK_TYPE_ID = 0x7;
+
+struct TypeStats {
+    uint64_t frames = 0;
+    uint64_t messages = 0;          // vollständig (SINGLE oder fragmentiert mit gültiger CRC)
+    uint64_t fragmented = 0;
+    uint64_t bytes = 0;
+    uint64_t crcErrors = 0;
+    uint64_t expired = 0;
+    uint64_t orphans = 0;
+    uint64_t limited = 0;           // LIMIT: Grenzen überschritten
+    uint64_t retransmissions = 0;
+    uint64_t transferSumUs = 0;     // START → END
+    int64_t  transferMaxUs = 0;
+    uint64_t acks = 0;
+    uint64_t ackSumUs = 0;          // END → ACK
+    int64_t  ackMaxUs = 0;
+
+    void merge(const TypeStats& o) {
+        frames += o.frames; messages += o.messages; fragmented += o.fragmented;
+        bytes += o.bytes; crcErrors += o.crcErrors; expired += o.expired;
+        orphans += o.orphans; limited += o.limited; retransmissions += o.retransmissions;
+        transferSumUs += o.transferSumUs; transferMaxUs = std::max(transferMaxUs, o.transferMaxUs);
+        acks += o.acks; ackSumUs += o.ackSumUs; ackMaxUs = std::max(ackMaxUs, o.ackMaxUs);
+    }
+};
+
+struct Result {
+    TypeStats types[8];
+};
+
+// Beginn der Einspielphase für den Bereich ab Block first: WARMUP_US vor dem letzten
+// Frame davor (bzw. vor dem Blockanfang, falls früher), nur innerhalb der Sitzung
+static int64_t warmupFrom(const CaptureFile& file, size_t first) {
+    int64_t t = file.baseUs(first);
+    if (first > file.session(file.sessionOf(first)).first) t = std::min(t, file.lastUs(first - 1));
+    return t - WARMUP_US;
+}
+
+// Wertet die Blöcke [first, last) aus; Frames ab fromUs in [warmup, first) dienen nur
+// dem Zustandsaufbau
+static void analyzeRange(const CaptureFile& file, const CANReassembler::Limits& limits,
+                         size_t warmup, int64_t fromUs, size_t first, size_t last, Result& res) {
+    CANReassembler reasm(REASSEMBLY_TIMEOUT_US);
+    reasm.setLimits(limits);
+    CANReassembler::Message msg;
+    struct LastMsg { int64_t timeUs; uint8_t crc; size_t len; bool acked; };
+    struct Pending { int64_t endUs; uint32_t baseId; };
+    std::unordered_map<uint32_t, LastMsg> lastByBase;      // für Wiederholungserkennung
+    std::unordered_map<uint16_t, Pending> awaitingAck;      // (Adresse << 3 | Typ) → letztes END
+
+    for (size_t b = warmup; b < last; ++b) {
+        // Neue Sitzung (angehängter Mitschnitt, Zeit beginnt neu): offene Nachrichten
+        // verfallen wie am Dateiende ungezählt
+        if (b > warmup && file.session(file.sessionOf(b)).first == b) {
+            reasm.clear();
+            lastByBase.clear();
+            awaitingAck.clear();
+        }
+        const CANCapture::BlockHeader& h = file.block(b);
+        const CANCapture::Record* r = file.records(b);
+        const bool count = b >= first;
+        const uint16_t records = file.recordCount(b);
+        for (uint16_t i = 0; i < records; ++i) {
+            const int64_t t = h.baseUs + r[i].deltaUs;
+            if (!count && t < fromUs) continue;
+            const uint16_t id = r[i].identifier;
+            const uint8_t type = id & 0x07;
+            const uint8_t seq = (id >> 3) & 0x03;
+            const uint8_t addr = (id >> 5) & 0x0F;
+            TypeStats& ts = res.types[type];
+            if (count) ++ts.frames;
+
+            reasm.purge(t, [&](uint32_t baseId) {
+                if (count) ++res.types[baseId & 0x07].expired;
+            });
+
+            if (type == ACK_TYPE_ID) {
+                if (r[i].dlc < 1) continue;
+                auto it = awaitingAck.find(static_cast<uint16_t>((addr << 3) | (r[i].data[0] & 0x07)));
+                if (it == awaitingAck.end()) continue;
+                const Pending p = it->second;
+                awaitingAck.erase(it);
+                const int64_t lat = t - p.endUs;
+                if (lat > RETRANSMIT_WINDOW_US) continue;
+                auto acked = lastByBase.find(p.baseId);
+                if (acked != lastByBase.end()) acked->second.acked = true;
+                if (count) {
+                    TypeStats& as = res.types[r[i].data[0] & 0x07];
+                    ++as.acks;
+                    as.ackSumUs += lat;
+                    as.ackMaxUs = std::max(as.ackMaxUs, lat);
+                }
+                continue;
+            }
+            if (seq == 3) {         // SINGLE
+                if (count) { ++ts.messages; ts.bytes += r[i].dlc; }
+                continue;
+            }
+
+            CANReassembler::Result rr = reasm.push(id, r[i].data, r[i].dlc, t, msg);
+            if (!count) {
+                if (rr == CANReassembler::COMPLETE) {
+                    uint8_t crc = CANReassembler::crc8(msg.data.data(), msg.data.size());
+                    lastByBase[msg.baseId] = LastMsg{t, crc, msg.data.size(), false};
+                    awaitingAck[static_cast<uint16_t>((addr << 3) | type)] = Pending{t, msg.baseId};
+                }
+                continue;
+            }
+            switch (rr) {
+            case CANReassembler::COMPLETE: {
+                ++ts.messages;
+                ++ts.fragmented;
+                ts.bytes += msg.data.size();
+                int64_t dur = msg.lastUs - msg.firstUs;
+                ts.transferSumUs += dur;
+                ts.transferMaxUs = std::max(ts.transferMaxUs, dur);
+                uint8_t crc = CANReassembler::crc8(msg.data.data(), msg.data.size());
+                auto prev = lastByBase.find(msg.baseId);
+                if (prev != lastByBase.end() && !prev->second.acked &&
+                    t - prev->second.timeUs <= RETRANSMIT_WINDOW_US &&
+                    prev->second.crc == crc && prev->second.len == msg.data.size())
+                    ++ts.retransmissions;
+                lastByBase[msg.baseId] = LastMsg{t, crc, msg.data.size(), false};
+                awaitingAck[static_cast<uint16_t>((addr << 3) | type)] = Pending{t, msg.baseId};
+                break;
+            }
+            case CANReassembler::CRC_ERROR: ++ts.crcErrors; break;
+            case CANReassembler::EXPIRED:   ++ts.expired; break;
+            case CANReassembler::ORPHAN:    ++ts.orphans; break;
+            case CANReassembler::LIMIT:     ++ts.limited; break;
+            default: break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: can_analyze FILE [--threads N] [--max-bytes N] [--max-frames N] "
+                        "[--max-contexts N]\n");
+        return 2;
+    }
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    CANReassembler::Limits limits;
+    for (int i = 2; i < argc; ++i) {
+        if (i + 1 >= argc) break;
+        if (!strcmp(argv[i], "--threads"))
+            threads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--max-bytes"))
+            limits.maxBytes = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--max-frames"))
+            limits.maxFrames = static_cast<uint16_t>(std::min(65535, std::max(1, atoi(argv[++i]))));
+        else if (!strcmp(argv[i], "--max-contexts"))
+            limits.maxContexts = std::max(1, atoi(argv[++i]));
+    }
+
+    CaptureFile file;
+    if (!file.open(argv[1])) {
+        fprintf(stderr, "cannot open capture '%s'\n", argv[1]);
+        return 1;
+    }
+    const size_t blocks = file.blockCount();
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(blocks, 1)));
+
+    std::vector<Result> results(threads);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t first = blocks * t / threads;
+        size_t last = blocks * (t + 1) / threads;
+        int64_t fromUs = (t == 0 || first >= blocks) ? 0 : warmupFrom(file, first);
+        size_t warmup = (t == 0 || first >= blocks)
+                        ? first : file.findBlock(fromUs, file.session(file.sessionOf(first)).first, first);
+        pool.emplace_back(analyzeRange, std::cref(file), std::cref(limits), warmup, fromUs, first, last,
+                          std::ref(results[t]));
+    }
+    for (std::thread& th : pool) th.join();
+
+    Result total;
+    for (const Result& r : results)
+        for (int type = 0; type < 8; ++type) total.types[type].merge(r.types[type]);
+
+    const double seconds = std::max(1e-6, file.durationUs() / 1e6);
+    printf("# blocks=%zu sessions=%zu threads=%u duration_s=%.3f max_bytes=%zu max_frames=%u "
+           "max_contexts=%zu\n", blocks, file.sessionCount(), threads, seconds, limits.maxBytes,
+           unsigned(limits.maxFrames), limits.maxContexts);
+    printf("type,frames,messages,msg_per_s,bytes,fragmented,crc_errors,expired,orphans,limit,"
+           "retransmissions,transfer_avg_us,transfer_max_us,acks,ack_avg_us,ack_max_us\n");
+    for (int type = 0; type < 8; ++type) {
+        const TypeStats& s = total.types[type];
+        if (!s.frames) continue;
+        printf("%d,%llu,%llu,%.2f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.1f,%lld,%llu,%.1f,%lld\n", type,
+               (unsigned long long)s.frames, (unsigned long long)s.messages, s.messages / seconds,
+               (unsigned long long)s.bytes, (unsigned long long)s.fragmented,
+               (unsigned long long)s.crcErrors, (unsigned long long)s.expired,
+               (unsigned long long)s.orphans, (unsigned long long)s.limited,
+               (unsigned long long)s.retransmissions,
+               s.fragmented ? double(s.transferSumUs) / s.fragmented : 0.0, (long long)s.transferMaxUs,
+               (unsigned long long)s.acks, s.acks ? double(s.ackSumUs) / s.acks : 0.0,
+               (long long)s.ackMaxUs);
+    }
+    return 0;
+}
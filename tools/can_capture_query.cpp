@@ -0,0 +1,63 @@
+/**
+can_capture_query – Capture-Datei nach Zeit und Identifier abfragen
+===================================================================
+Build (Linux/macOS):
+  g++ -std=c++11 -O2 -Ilib/esp32_can_library -Itools tools/can_capture_query.cpp -o can_capture_query
+
+Aufruf:
+  can_capture_query DATEI [--from µs] [--to µs] [--id 0x123]... [--info]
+
+Ausgabe im candump-Logformat (-L), direkt weiterverwendbar mit can-utils. */
+#include "capture_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+static void usage() {
+    fprintf(stderr, "usage: can_capture_query FILE [--from US] [--to US] [--id ID]... [--info]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) { usage(); return 2; }
+    const char* path = argv[1];
+    int64_t fromUs = std::numeric_limits<int64_t>::min();
+    int64_t toUs = std::numeric_limits<int64_t>::max();
+    std::vector<uint16_t> ids;
+    bool info = false;
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "--from") && i + 1 < argc) fromUs = strtoll(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--to") && i + 1 < argc) toUs = strtoll(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--id") && i + 1 < argc)
+            ids.push_back(static_cast<uint16_t>(strtoul(argv[++i], nullptr, 0) & 0x7FF));
+        else if (!strcmp(argv[i], "--info")) info = true;
+        else { usage(); return 2; }
+    }
+
+    CaptureFile file;
+    if (!file.open(path)) {
+        fprintf(stderr, "cannot open capture '%s'\n", path);
+        return 1;
+    }
+    if (info) {
+        size_t frames = 0;
+        for (size_t b = 0; b < file.blockCount(); ++b) frames += file.recordCount(b);
+        printf("blocks=%zu frames=%zu sessions=%zu indexed=%d\n", file.blockCount(), frames,
+               file.sessionCount(), file.indexed() ? 1 : 0);
+        for (size_t s = 0; s < file.sessionCount(); ++s) {
+            const CaptureFile::Session& ss = file.session(s);
+            printf("session=%zu blocks=%zu first_us=%lld last_us=%lld\n", s, ss.last - ss.first,
+                   static_cast<long long>(file.baseUs(ss.first)),
+                   static_cast<long long>(file.lastUs(ss.last - 1)));
+        }
+        return 0;
+    }
+
+    file.query(fromUs, toUs, ids, [](const CaptureFile::Frame& f) {
+        printf("(%lld.%06lld) can0 %03X#", static_cast<long long>(f.timeUs / 1000000),
+               static_cast<long long>(f.timeUs % 1000000), f.rec->identifier);
+        for (uint8_t i = 0; i < f.rec->dlc && i < 8; ++i) printf("%02X", f.rec->data[i]);
+        putchar('\n');
+    });
+    return 0;
+}
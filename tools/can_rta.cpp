@@ -0,0 +1,93 @@
+/**
+can_rta – Worst-Case-Antwortzeiten und Busauslastung aus Nachrichtendefinitionen
+================================================================================
+Liest eine CSV (Format wie CANRta::writeCsv, z. B. aus der Firmware über die Registry
+von DEFINE_CAN_MESSAGE_TIMED oder von Hand für geplante Nachrichten) und führt die
+Analyse aus can_rta.h aus. Exit-Code 1, wenn eine Deadline verletzt wird (für CI).
+
+CSV-Spalten (Kopfzeile und Zeilen mit # werden übersprungen):
+  name,type,prio,addr,bytes,period_ms,deadline_ms[,jitter_ms[,acked]]
+  addr: 0–15 oder * (unbekannt); deadline_ms 0 = keine; acked: 1 = Empfänger quittiert
+  (Default: 1 für Nachrichten > 8 Byte). Mit CANBUS_LATENCY_TRACE 3 Byte zu bytes
+  addieren, wenn die Nachricht dadurch keinen Frame mehr braucht (CANBus::TxLayout; die
+  Registry schreibt bereits die gesendete Länge).
+
+Build (Linux/macOS):
+  g++ -std=c++11 -O2 -Ilib/esp32_can_library tools/can_rta.cpp -o can_rta
+
+Aufruf:
+  can_rta DATEI [--bitrate 500000] [--no-ack] */
+#include "can_rta.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static bool parseLine(char* line, CANRta::Message& m) {
+    char* fields[9] = {};
+    size_t n = 0;
+    for (char* tok = strtok(line, ",\r\n"); tok && n < 9; tok = strtok(nullptr, ",\r\n"))
+        fields[n++] = tok;
+    if (n < 7) return false;
+    m.name = fields[0];
+    m.type = static_cast<uint8_t>(strtoul(fields[1], nullptr, 0) & 0x07);
+    m.prio = static_cast<uint8_t>(strtoul(fields[2], nullptr, 0) & 0x03);
+    m.addr = fields[3][0] == '*' ? CANRta::ANY_ADDR : static_cast<uint8_t>(strtoul(fields[3], nullptr, 0) & 0x0F);
+    m.bytes = static_cast<uint16_t>(strtoul(fields[4], nullptr, 0));
+    m.periodUs = static_cast<uint32_t>(strtod(fields[5], nullptr) * 1000);
+    m.deadlineUs = static_cast<uint32_t>(strtod(fields[6], nullptr) * 1000);
+    m.jitterUs = n > 7 ? static_cast<uint32_t>(strtod(fields[7], nullptr) * 1000) : 0;
+    m.acked = n > 8 ? atoi(fields[8]) != 0 : m.bytes > 8;
+    return m.periodUs > 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: can_rta FILE [--bitrate N] [--no-ack]\n");
+        return 2;
+    }
+    uint32_t bitrate = 500000;
+    bool acks = true;
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "--bitrate") && i + 1 < argc) bitrate = static_cast<uint32_t>(atol(argv[++i]));
+        else if (!strcmp(argv[i], "--no-ack")) acks = false;
+    }
+    if (bitrate == 0) bitrate = 500000;
+
+    FILE* f = fopen(argv[1], "r");
+    if (!f) {
+        fprintf(stderr, "cannot open '%s'\n", argv[1]);
+        return 2;
+    }
+    CANRta rta(bitrate);
+    char line[256];
+    unsigned lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        ++lineNo;
+        if (line[0] == '#' || line[0] == '\n' || !strncmp(line, "name,", 5)) continue;
+        CANRta::Message m;
+        if (!parseLine(line, m)) {
+            fprintf(stderr, "%s:%u: invalid line\n", argv[1], lineNo);
+            fclose(f);
+            return 2;
+        }
+        if (!acks) m.acked = false;
+        rta.add(m);
+    }
+    fclose(f);
+
+    CANRta::Report rep = rta.analyze();
+    printf("# bitrate=%u utilization=%.1f%% schedulable=%s\n", bitrate, rep.utilization * 100,
+           rep.schedulable ? "yes" : "no");
+    printf("name,id_min,id_max,frames,c_us,period_us,deadline_us,wcrt_us,slack_us,ok\n");
+    for (const CANRta::Result& r : rep.results) {
+        const bool bounded = r.responseUs != UINT32_MAX;
+        printf("%s,0x%03X,0x%03X,%u,%u,%u,%u,", r.name.c_str(), r.minId, r.maxId, r.frames,
+               r.transmitUs, r.periodUs, r.deadlineUs);
+        if (bounded) printf("%u,", r.responseUs);
+        else printf("inf,");
+        if (r.deadlineUs && bounded) printf("%lld,", static_cast<long long>(r.deadlineUs) - r.responseUs);
+        else printf(",");
+        printf("%s\n", r.schedulable ? "yes" : "NO");
+    }
+    return rep.schedulable ? 0 : 1;
+}
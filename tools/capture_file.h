@@ -0,0 +1,267 @@
+/**
+Host-Leser für Capture-Dateien (Format: lib/esp32_can_library/can_capture.h)
+===========================================================================
+Die Datei wird per mmap eingeblendet. open() sucht per Binärsuche den letzten
+beschriebenen Block (dahinter nur gelöschte 0xFF-Blöcke, z. B. Partitions-Dump mit
+esptool read_flash) und liest von dort die Trailer und Indexblöcke der Sitzungen
+rückwärts – O(Sitzungen + Blöcke / INDEX_ENTRIES) Seiten statt aller Blockheader.
+Datenblöcke und Records werden erst bei einer Abfrage angefasst.
+
+Ohne gültigen Trailer (abgebrochener Mitschnitt, Dateien ohne Index) liest open() alle
+Blockheader in Dateireihenfolge und überspringt gelöschte, fremde und Indexblöcke; eine
+neue Sitzung beginnt dort, wo seq nicht weiter steigt.
+
+Jede Sitzung ist für sich zeitlich geordnet, Sitzungen untereinander nicht (nach einem
+Neustart beginnt die Zeit wieder bei 0): findBlock() sucht innerhalb einer Sitzung,
+query() fragt alle Sitzungen nacheinander ab.
+
+Nur POSIX (Linux/macOS). */
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include "can_capture.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class CaptureFile {
+public:
+    // Ein Frame mit absolutem Zeitstempel
+    struct Frame {
+        int64_t timeUs;
+        const CANCapture::Record* rec;
+    };
+
+    CaptureFile() = default;
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+    ~CaptureFile() { close(); }
+
+    struct Session {
+        size_t first;               // Blöcke [first, last)
+        size_t last;
+    };
+
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(CANCapture::BLOCK_SIZE)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { size_ = 0; return false; }
+        base_ = static_cast<const uint8_t*>(p);
+        madvise(p, size_, MADV_RANDOM);
+
+        indexed_ = readIndex();
+        if (!indexed_) scanHeaders();
+        return true;
+    }
+
+    void close() {
+        if (base_) munmap(const_cast<uint8_t*>(base_), size_);
+        base_ = nullptr;
+        size_ = 0;
+        blocks_.clear();
+        sessions_.clear();
+        indexed_ = false;
+    }
+
+    // true: Blöcke aus den Sitzungsindizes, false: alle Header gelesen
+    bool indexed() const { return indexed_; }
+
+    size_t blockCount() const { return blocks_.size(); }
+    const CANCapture::BlockHeader& block(size_t i) const { return *blocks_[i].h; }
+
+    // Records des Blocks; 0, wenn der Block nicht zum Index passt
+    uint16_t recordCount(size_t i) const {
+        const Block& b = blocks_[i];
+        if (b.h->magic != CANCapture::BLOCK_MAGIC || b.h->seq != b.seq) return 0;
+        return b.h->count > CANCapture::RECORDS_PER_BLOCK ? 0 : b.h->count;
+    }
+
+    const CANCapture::Record* records(size_t i) const {
+        return reinterpret_cast<const CANCapture::Record*>(
+            reinterpret_cast<const uint8_t*>(blocks_[i].h) + sizeof(CANCapture::BlockHeader));
+    }
+
+    int64_t baseUs(size_t i) const { return blocks_[i].baseUs; }
+    int64_t lastUs(size_t i) const { return blocks_[i].lastUs; }
+
+    size_t sessionCount() const { return sessions_.size(); }
+    const Session& session(size_t s) const { return sessions_[s]; }
+
+    // Sitzung, zu der Block i gehört
+    size_t sessionOf(size_t i) const {
+        return std::upper_bound(sessions_.begin(), sessions_.end(), i,
+                                [](size_t b, const Session& s) { return b < s.first; }) -
+               sessions_.begin() - 1;
+    }
+
+    int64_t firstUs() const { return blocks_.empty() ? 0 : blocks_.front().baseUs; }
+    int64_t lastUs() const { return blocks_.empty() ? 0 : blocks_.back().lastUs; }
+
+    // Summe der Zeitspannen aller Sitzungen
+    int64_t durationUs() const {
+        int64_t d = 0;
+        for (const Session& s : sessions_) d += blocks_[s.last - 1].lastUs - blocks_[s.first].baseUs;
+        return d;
+    }
+
+    // Erster Block in [first, last) (einer Sitzung), dessen Zeitbereich bis mindestens
+    // timeUs reicht; Binärsuche über den Index, ohne Datenblöcke zu lesen
+    size_t findBlock(int64_t timeUs, size_t first, size_t last) const {
+        return std::lower_bound(blocks_.begin() + first, blocks_.begin() + last, timeUs,
+                                [](const Block& b, int64_t t) { return b.lastUs < t; }) -
+               blocks_.begin();
+    }
+
+    // Alle Frames in [fromUs, toUs] aus den Blöcken [first, last), optional nur bestimmte
+    // Identifier (leer = alle). Blöcke ohne passenden Identifier werden nicht gelesen.
+    template<typename F>
+    size_t scan(size_t first, size_t last, int64_t fromUs, int64_t toUs,
+                const std::vector<uint16_t>& ids, F f) const {
+        size_t n = 0;
+        for (size_t b = first; b < last && b < blocks_.size(); ++b) {
+            if (blocks_[b].baseUs > toUs) break;
+            if (blocks_[b].lastUs < fromUs) continue;
+            const CANCapture::BlockHeader& h = *blocks_[b].h;
+            const uint16_t count = recordCount(b);
+            if (!count || !matchesBlock(h, ids)) continue;
+            const CANCapture::Record* r = records(b);
+            for (uint16_t i = 0; i < count; ++i) {
+                int64_t t = h.baseUs + r[i].deltaUs;
+                if (t < fromUs || t > toUs) continue;
+                if (!ids.empty() && std::find(ids.begin(), ids.end(), r[i].identifier) == ids.end())
+                    continue;
+                f(Frame{t, &r[i]});
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // Alle Sitzungen in Dateireihenfolge
+    template<typename F>
+    size_t query(int64_t fromUs, int64_t toUs, const std::vector<uint16_t>& ids, F f) const {
+        size_t n = 0;
+        for (const Session& s : sessions_)
+            n += scan(findBlock(fromUs, s.first, s.last), s.last, fromUs, toUs, ids, f);
+        return n;
+    }
+
+private:
+    struct Block {
+        const CANCapture::BlockHeader* h;
+        uint32_t seq;
+        int64_t baseUs;
+        int64_t lastUs;
+    };
+
+    size_t fileBlocks() const { return size_ / CANCapture::BLOCK_SIZE; }
+
+    const uint8_t* at(size_t i) const { return base_ + i * CANCapture::BLOCK_SIZE; }
+
+    bool erased(size_t i) const {
+        uint32_t magic;
+        memcpy(&magic, at(i), sizeof(magic));
+        return magic == 0xFFFFFFFF;
+    }
+
+    const CANCapture::IndexHeader* indexAt(size_t i) const {
+        const CANCapture::IndexHeader* ih = reinterpret_cast<const CANCapture::IndexHeader*>(at(i));
+        if (ih->magic != CANCapture::INDEX_MAGIC || ih->version != CANCapture::VERSION ||
+            ih->count > CANCapture::INDEX_ENTRIES)
+            return nullptr;
+        return ih;
+    }
+
+    // Sitzungen vom letzten beschriebenen Block rückwärts über Trailer und Indexblöcke
+    bool readIndex() {
+        // Beschriebene Blöcke liegen vorn, gelöschte (0xFF) dahinter
+        size_t lo = 0, hi = fileBlocks();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (erased(mid)) hi = mid;
+            else lo = mid + 1;
+        }
+        std::vector<std::vector<Block>> sessions;       // rückwärts gesammelt
+        size_t end = lo;                                // Blöcke [0, end) beschrieben
+        while (end > 0) {
+            const CANCapture::IndexHeader* trailer = indexAt(end - 1);
+            if (!trailer || !(trailer->flags & CANCapture::INDEX_TRAILER) ||
+                trailer->sessionBlocks == 0 || trailer->sessionBlocks > end)
+                return false;
+            const size_t start = end - trailer->sessionBlocks;
+            std::vector<Block> blocks;
+            size_t pos = end - 1;                       // aktueller Indexblock
+            while (true) {
+                const CANCapture::IndexHeader* ih = indexAt(pos);
+                if (!ih || ih->count > pos - start) return false;
+                const CANCapture::IndexEntry* e =
+                    reinterpret_cast<const CANCapture::IndexEntry*>(at(pos) + sizeof(*ih));
+                for (size_t k = ih->count; k-- > 0;) {
+                    const size_t b = pos - ih->count + k;
+                    if (e[k].count == 0 || e[k].count > CANCapture::RECORDS_PER_BLOCK) continue;
+                    blocks.push_back(Block{reinterpret_cast<const CANCapture::BlockHeader*>(at(b)),
+                                           e[k].seq, e[k].baseUs, e[k].lastUs});
+                }
+                if (pos - ih->count == start) break;
+                pos -= ih->count + 1;
+                if (pos < start) return false;
+            }
+            std::reverse(blocks.begin(), blocks.end());
+            sessions.push_back(std::move(blocks));
+            end = start;
+        }
+        for (size_t s = sessions.size(); s-- > 0;) addSession(sessions[s]);
+        return true;
+    }
+
+    // Ohne Index: alle Header in Dateireihenfolge
+    void scanHeaders() {
+        std::vector<Block> blocks;
+        for (size_t i = 0; i < fileBlocks(); ++i) {
+            const CANCapture::BlockHeader* h = reinterpret_cast<const CANCapture::BlockHeader*>(at(i));
+            if (h->magic != CANCapture::BLOCK_MAGIC || h->version != CANCapture::VERSION) continue;
+            if (h->count == 0 || h->count > CANCapture::RECORDS_PER_BLOCK) continue;
+            if (!blocks.empty() && h->seq <= blocks.back().seq) {
+                addSession(blocks);
+                blocks.clear();
+            }
+            blocks.push_back(Block{h, h->seq, h->baseUs, h->lastUs});
+        }
+        addSession(blocks);
+    }
+
+    void addSession(const std::vector<Block>& blocks) {
+        if (blocks.empty()) return;
+        sessions_.push_back(Session{blocks_.size(), blocks_.size() + blocks.size()});
+        blocks_.insert(blocks_.end(), blocks.begin(), blocks.end());
+    }
+
+    static bool matchesBlock(const CANCapture::BlockHeader& h, const std::vector<uint16_t>& ids) {
+        if (ids.empty()) return true;
+        for (uint16_t id : ids)
+            if (CANCapture::hasId(h, id)) return true;
+        return false;
+    }
+
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Block> blocks_;         // Sitzungen hintereinander, je Sitzung nach seq
+    std::vector<Session> sessions_;
+    bool indexed_ = false;
+};
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,95 @@
+/**
+Replay eines Mitschnitts in CANBus-Instanzen (Host-Simulation)
+==============================================================
+Spielt die Frames einer Capture-Datei (CaptureFile) in Mitschnittreihenfolge an alle
+registrierten Ziele aus; je Frame werden die Ziele in Registrierungsreihenfolge bedient.
+Zeitstempel werden aus dem Mitschnitt übergeben (CANBus::injectFrame), damit hängt das
+Ergebnis (Reassembly, Timeouts) nicht von der Abspielgeschwindigkeit ab und jeder Lauf
+ist reproduzierbar.
+
+Geschwindigkeit: 1 = Originaltiming, 10 = zehnfach, 0 = so schnell wie möglich
+(Durchsatzmessung des Empfangspfads).
+
+Beispiel:
+  CaptureFile file; file.open("field.cap");
+  CaptureReplay replay(file);
+  replay.addBus(bus);                 // beliebig viele CANBus-Instanzen
+  replay.setSpeed(0);
+  CaptureReplay::Stats s = replay.run();
+  printf("%.0f frames/s\n", s.framesPerSec());
+
+Build am PC mit CANBus als Ziel: Host-Shim statt ESP-IDF (tools/host/host_twai.h),
+  g++ -std=gnu++11 -pthread -Itools/host -Itools -Ilib/esp32_can_library ...
+Beispiel als Test: test/test_native (pio test -e native). */
+#ifndef CAPTURE_REPLAY_H
+#define CAPTURE_REPLAY_H
+
+#include "capture_file.h"
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+class CaptureReplay {
+public:
+    // Ziel je Frame: Identifier, Daten, DLC, Zeitstempel aus dem Mitschnitt (µs)
+    using Target = std::function<void(uint16_t, const uint8_t*, uint8_t, int64_t)>;
+
+    struct Stats {
+        uint64_t frames = 0;
+        int64_t  captureUs = 0;     // abgespielte Mitschnittdauer
+        int64_t  wallUs = 0;        // benötigte Echtzeit
+        int64_t  maxLagUs = 0;      // größte Verspätung gegenüber dem Soll (nur mit Timing)
+
+        double framesPerSec() const { return wallUs > 0 ? frames * 1e6 / wallUs : 0.0; }
+    };
+
+    explicit CaptureReplay(const CaptureFile& file) : file_(file) {}
+
+    void addTarget(Target t) { targets_.push_back(std::move(t)); }
+
+    // Jede Klasse mit injectFrame(id, data, dlc, timeUs), i. d. R. CANBus
+    template<typename Bus>
+    void addBus(Bus& bus) {
+        addTarget([&bus](uint16_t id, const uint8_t* data, uint8_t dlc, int64_t timeUs) {
+            bus.injectFrame(id, data, dlc, timeUs);
+        });
+    }
+
+    void setSpeed(double factor) { speed_ = factor > 0 ? factor : 0; }
+
+    // Frames in [fromUs, toUs] abspielen, optional nur bestimmte Identifier (leer = alle)
+    Stats run(int64_t fromUs = std::numeric_limits<int64_t>::min(),
+              int64_t toUs = std::numeric_limits<int64_t>::max(),
+              const std::vector<uint16_t>& ids = std::vector<uint16_t>()) {
+        using Clock = std::chrono::steady_clock;
+        Stats st;
+        const Clock::time_point start = Clock::now();
+        int64_t firstUs = 0, lastUs = 0;
+        file_.query(fromUs, toUs, ids, [&](const CaptureFile::Frame& f) {
+            if (st.frames == 0) firstUs = f.timeUs;
+            lastUs = f.timeUs;
+            if (speed_ > 0) {
+                Clock::time_point due = start + std::chrono::microseconds(
+                    static_cast<int64_t>((f.timeUs - firstUs) / speed_));
+                Clock::time_point now = Clock::now();
+                if (due > now) std::this_thread::sleep_until(due);
+                else st.maxLagUs = std::max<int64_t>(st.maxLagUs,
+                    std::chrono::duration_cast<std::chrono::microseconds>(now - due).count());
+            }
+            for (Target& t : targets_) t(f.rec->identifier, f.rec->data, f.rec->dlc, f.timeUs);
+            ++st.frames;
+        });
+        st.captureUs = lastUs - firstUs;
+        st.wallUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        return st;
+    }
+
+private:
+    const CaptureFile& file_;
+    std::vector<Target> targets_;
+    double speed_ = 1.0;
+};
+
+#endif // CAPTURE_REPLAY_H
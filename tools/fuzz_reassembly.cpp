@@ -0,0 +1,127 @@
+/**
+fuzz_reassembly – libFuzzer-Harness für Reassembly und Empfangspfad
+===================================================================
+Die Eingabe wird als Folge von Frames gelesen, wie sie ein beliebiger Knoten senden könnte:
+  [modus] dann je Frame: [id lo] [id hi (3 Bit)] [dlc] [zeit +ms] [data...]
+  (data: dlc Byte, dlc wird auf 8 begrenzt)
+Dieselben Frames laufen zweimal durch:
+1. CANReassembler direkt: die Grenzen (Limits) werden nie überschritten, der gepufferte
+   Speicher bleibt konsistent
+2. CANBus::injectFrame mit allem, was der Empfangspfad kann: Handler für einzelne und
+   fragmentierte Typen, Mailbox, Coalescing (Bündel, Type-ID 6), Zeitsync (SYNC/FOLLOW_UP
+   als Master oder Slave, Modus Bit 0), verzögerte Zustellung (Modus Bit 1), Trace und
+   Latenz-Trailer. Zeit läuft über VirtualClock mit den Frames mit.
+ASan/UBSan finden Speicherfehler.
+
+Build (clang, Host-Shim für den TWAI-Treiber):
+  clang++ -std=c++11 -g -O1 -fsanitize=fuzzer,address,undefined \
+      -DCANBUS_LATENCY_TRACE=1 -DCANBUS_TRACE_SIZE=64 \
+      -Itools/host -Ilib/esp32_can_library tools/fuzz_reassembly.cpp -o fuzz_reassembly
+  ./fuzz_reassembly -max_len=4096 CORPUS_DIR */
+#include "esp32_can_library.h"
+#include "can_reassembly.h"
+#include <cstdlib>
+
+DEFINE_CAN_MESSAGE(FuzzSmall, 0, uint8_t d[2];);
+DEFINE_CAN_MESSAGE(FuzzFull, 1, uint8_t d[8];);
+DEFINE_CAN_MESSAGE(FuzzMedium, 2, uint8_t d[20];);
+DEFINE_CAN_MESSAGE(FuzzLarge, 3, uint8_t d[61];);
+DEFINE_CAN_MESSAGE(FuzzWord, 4, uint32_t v;);
+DEFINE_CAN_MESSAGE(FuzzBox, 5, uint8_t d[12];);
+DEFINE_CAN_MESSAGE(FuzzBundled, 6, uint8_t d[40];);       // fragmentiert trotz Coalescing
+
+static volatile uint32_t g_sink;
+
+template<typename T>
+static void fuzzHandler(CANBus& bus) {
+    bus.onReceive<T>([](const T& m, const CANBus::RxInfo& info) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&m);
+        for (size_t i = 0; i < sizeof(T); ++i) g_sink += p[i];
+        if (info.prio > 3 || info.dest > 15 || info.lastUs < info.firstUs) abort();
+    });
+}
+
+struct FuzzFrame {
+    uint32_t id;
+    uint8_t dlc;
+    int64_t timeUs;
+    uint8_t data[8];
+};
+
+static void fuzzReassembler(const std::vector<FuzzFrame>& frames) {
+    // Kleine Grenzen, damit der Fuzzer sie schnell erreicht
+    CANReassembler::Limits limits;
+    limits.maxBytes = 64;
+    limits.maxFrames = 12;
+    limits.maxContexts = 4;
+    CANReassembler r(500000);
+    r.setLimits(limits);
+    CANReassembler::Message msg;
+    for (const FuzzFrame& f : frames) {
+        if (((f.id >> 3) & 0x03) == 3) continue;     // SINGLE läuft nicht durch die Reassembly
+        CANReassembler::Result res = r.push(f.id, f.data, f.dlc, f.timeUs, msg);
+        if (res == CANReassembler::COMPLETE && msg.data.size() + 1 > limits.maxBytes) abort();
+        if (r.pending() > limits.maxContexts) abort();
+        if (r.buffered() > limits.maxContexts * limits.maxBytes) abort();
+    }
+    r.clear();
+    if (r.buffered() != 0) abort();
+}
+
+static void fuzzBus(uint8_t mode, const std::vector<FuzzFrame>& frames) {
+    CANBus::VirtualClock::set(1000000);
+    CANBus bus(GPIO_NUM_5, GPIO_NUM_4);
+    bus.setClock(&CANBus::VirtualClock::now);
+    bus.setNodeAddress(1);
+    bus.setReassemblyLimits(64, 12, 4);
+    bus.setCoalescing(true, 1);
+    bus.setTimeSync(mode & 0x01 ? CANBus::SYNC_MASTER : CANBus::SYNC_SLAVE, 10);
+    const bool deferred = mode & 0x02;
+    if (deferred && bus.setDeferredDelivery(4) != ESP_OK) abort();
+    fuzzHandler<FuzzSmall>(bus);
+    fuzzHandler<FuzzFull>(bus);
+    fuzzHandler<FuzzMedium>(bus);
+    fuzzHandler<FuzzLarge>(bus);
+    fuzzHandler<FuzzWord>(bus);
+    fuzzHandler<FuzzBundled>(bus);
+    CANBus::Mailbox<FuzzBox> box;
+    bus.attachMailbox(box);
+
+    for (const FuzzFrame& f : frames) {
+        CANBus::VirtualClock::set(1000000 + f.timeUs);
+        bus.injectFrame(f.id, f.data, f.dlc, CANBus::VirtualClock::now());
+        if (deferred) bus.processReceived();
+        FuzzBox b;
+        if (box.read(b)) g_sink += b.d[0];
+    }
+    CANBus::TimeSyncStatus st = bus.timeSyncStatus();
+    g_sink += st.syncs + bus.busStats().reassemblyLimit;
+    bus.exportCandump([](const uint8_t* data, size_t len) {
+        if (len) g_sink += data[len - 1];
+    });
+    bus.dumpLatency([](const uint8_t*, size_t len) { g_sink += len; });
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* in, size_t size) {
+    if (size < 1) return 0;
+    const uint8_t mode = in[0];
+    std::vector<FuzzFrame> frames;
+    int64_t nowUs = 0;
+    size_t pos = 1;
+    while (pos + 4 <= size) {
+        FuzzFrame f{};
+        f.id = in[pos] | (static_cast<uint32_t>(in[pos + 1] & 0x07) << 8);
+        f.dlc = in[pos + 2];
+        nowUs += static_cast<int64_t>(in[pos + 3]) * 1000;
+        f.timeUs = nowUs;
+        pos += 4;
+        uint8_t n = f.dlc > 8 ? 8 : f.dlc;
+        if (pos + n > size) break;
+        for (uint8_t i = 0; i < n; ++i) f.data[i] = in[pos + i];
+        pos += n;
+        frames.push_back(f);
+    }
+    fuzzReassembler(frames);
+    fuzzBus(mode, frames);
+    return 0;
+}
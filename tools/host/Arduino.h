@@ -0,0 +1,25 @@
+// Host-Shim: nur was bench/main.cpp braucht (Serial.printf/println, delay)
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+struct HostSerial {
+    void begin(unsigned long) {}
+    template<typename... Args>
+    void printf(const char* fmt, Args... args) { ::printf(fmt, args...); }
+    void println(const char* s) { ::puts(s); }
+};
+
+static HostSerial Serial;
+
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+#endif // HOST_ARDUINO_H
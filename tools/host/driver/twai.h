@@ -0,0 +1,280 @@
+// Host-Shim: TWAI-Treiber ohne Hardware. Ein Controller je Prozess wie auf dem ESP32;
+// gesendete Frames landen im TX-Log (und bei Self-Reception/Loopback in der RX-Queue),
+// empfangene Frames speisen Tests über host_twai.h ein.
+#ifndef HOST_DRIVER_TWAI_H
+#define HOST_DRIVER_TWAI_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6,
+    GPIO_NUM_7, GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12, GPIO_NUM_13,
+    GPIO_NUM_14, GPIO_NUM_15, GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_21 = 21,
+    GPIO_NUM_22, GPIO_NUM_23, GPIO_NUM_25 = 25, GPIO_NUM_26, GPIO_NUM_27, GPIO_NUM_32 = 32,
+    GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_36, GPIO_NUM_37, GPIO_NUM_38, GPIO_NUM_39
+} gpio_num_t;
+
+typedef enum { TWAI_MODE_NORMAL, TWAI_MODE_NO_ACK, TWAI_MODE_LISTEN_ONLY } twai_mode_t;
+typedef enum { TWAI_STATE_STOPPED, TWAI_STATE_RUNNING, TWAI_STATE_BUS_OFF, TWAI_STATE_RECOVERING } twai_state_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t extd: 1;
+            uint32_t rtr: 1;
+            uint32_t ss: 1;
+            uint32_t self: 1;
+            uint32_t dlc_non_comp: 1;
+            uint32_t reserved: 27;
+        };
+        uint32_t flags;
+    };
+    uint32_t identifier;
+    uint8_t data_length_code;
+    uint8_t data[8];
+} twai_message_t;
+
+typedef struct {
+    twai_mode_t mode;
+    gpio_num_t tx_io;
+    gpio_num_t rx_io;
+    gpio_num_t clkout_io;
+    gpio_num_t bus_off_io;
+    uint32_t tx_queue_len;
+    uint32_t rx_queue_len;
+    uint32_t alerts_enabled;
+    uint32_t clkout_divider;
+    int intr_flags;
+} twai_general_config_t;
+
+typedef struct {
+    uint32_t brp;
+    uint8_t tseg_1;
+    uint8_t tseg_2;
+    uint8_t sjw;
+    bool triple_sampling;
+} twai_timing_config_t;
+
+typedef struct {
+    uint32_t acceptance_code;
+    uint32_t acceptance_mask;
+    bool single_filter;
+} twai_filter_config_t;
+
+typedef struct {
+    twai_state_t state;
+    uint32_t msgs_to_tx;
+    uint32_t msgs_to_rx;
+    uint32_t tx_error_counter;
+    uint32_t rx_error_counter;
+    uint32_t tx_failed_count;
+    uint32_t rx_missed_count;
+    uint32_t rx_overrun_count;
+    uint32_t arb_lost_count;
+    uint32_t bus_error_count;
+} twai_status_info_t;
+
+// Bit-Timing für 80 MHz APB-Takt wie in ESP-IDF
+#define TWAI_TIMING_CONFIG_25KBITS()  {128, 16, 8, 3, false}
+#define TWAI_TIMING_CONFIG_50KBITS()  {80, 15, 4, 3, false}
+#define TWAI_TIMING_CONFIG_100KBITS() {40, 15, 4, 3, false}
+#define TWAI_TIMING_CONFIG_125KBITS() {32, 15, 4, 3, false}
+#define TWAI_TIMING_CONFIG_250KBITS() {16, 15, 4, 3, false}
+#define TWAI_TIMING_CONFIG_500KBITS() {8, 15, 4, 3, false}
+#define TWAI_TIMING_CONFIG_800KBITS() {4, 16, 8, 3, false}
+#define TWAI_TIMING_CONFIG_1MBITS()   {4, 15, 4, 3, false}
+
+#define TWAI_ALERT_TX_IDLE              0x00000001
+#define TWAI_ALERT_TX_SUCCESS           0x00000002
+#define TWAI_ALERT_RX_DATA              0x00000004
+#define TWAI_ALERT_BELOW_ERR_WARN       0x00000008
+#define TWAI_ALERT_ERR_ACTIVE           0x00000010
+#define TWAI_ALERT_RECOVERY_IN_PROGRESS 0x00000020
+#define TWAI_ALERT_BUS_RECOVERED        0x00000040
+#define TWAI_ALERT_ARB_LOST             0x00000080
+#define TWAI_ALERT_ABOVE_ERR_WARN       0x00000100
+#define TWAI_ALERT_BUS_ERROR            0x00000200
+#define TWAI_ALERT_TX_FAILED            0x00000400
+#define TWAI_ALERT_RX_QUEUE_FULL        0x00000800
+#define TWAI_ALERT_ERR_PASS             0x00001000
+#define TWAI_ALERT_BUS_OFF              0x00002000
+#define TWAI_ALERT_RX_FIFO_OVERRUN      0x00004000
+#define TWAI_ALERT_TX_RETRIED           0x00008000
+#define TWAI_ALERT_PERIPH_RESET         0x00010000
+#define TWAI_ALERT_ALL                  0x0001FFFF
+#define TWAI_ALERT_NONE                 0x00000000
+
+namespace hosttwai {
+
+struct Driver {
+    std::mutex m;
+    std::condition_variable cv;
+    bool installed = false;
+    twai_general_config_t general{};
+    twai_timing_config_t timing{};
+    twai_filter_config_t filter{};
+    twai_state_t state = TWAI_STATE_STOPPED;
+    std::deque<twai_message_t> rx;
+    std::vector<twai_message_t> tx;                     // alle gesendeten Frames
+    bool txLog = true;                                  // false: TX-Log aus (Benchmarks)
+    uint32_t alerts = 0;                                // anstehend (nur aktivierte)
+    uint32_t rxMissed = 0;
+    bool loopback = false;                              // jeder Frame auch in die RX-Queue
+    std::function<void(const twai_message_t&)> onTransmit;   // z. B. zweiter Knoten
+};
+
+inline Driver& driver() {
+    static Driver d;
+    return d;
+}
+
+// Erwartet gesperrtes d.m
+inline void raise(Driver& d, uint32_t alerts) {
+    d.alerts |= alerts & d.general.alerts_enabled;
+    d.cv.notify_all();
+}
+
+inline void enqueueRx(Driver& d, const twai_message_t& m) {
+    if (d.rx.size() >= d.general.rx_queue_len) {
+        ++d.rxMissed;
+        raise(d, TWAI_ALERT_RX_QUEUE_FULL);
+        return;
+    }
+    d.rx.push_back(m);
+    raise(d, TWAI_ALERT_RX_DATA);
+    d.cv.notify_all();
+}
+
+} // namespace hosttwai
+
+inline esp_err_t twai_driver_install(const twai_general_config_t* g, const twai_timing_config_t* t,
+                                     const twai_filter_config_t* f) {
+    if (!g || !t || !f) return ESP_ERR_INVALID_ARG;
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (d.installed) return ESP_ERR_INVALID_STATE;
+    d.installed = true;
+    d.general = *g;
+    if (!d.general.rx_queue_len) d.general.rx_queue_len = 1;
+    d.timing = *t;
+    d.filter = *f;
+    d.state = TWAI_STATE_STOPPED;
+    d.alerts = 0;
+    return ESP_OK;
+}
+
+inline esp_err_t twai_driver_uninstall() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed || d.state == TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    d.installed = false;
+    d.rx.clear();
+    return ESP_OK;
+}
+
+inline esp_err_t twai_start() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed || d.state != TWAI_STATE_STOPPED) return ESP_ERR_INVALID_STATE;
+    d.state = TWAI_STATE_RUNNING;
+    return ESP_OK;
+}
+
+inline esp_err_t twai_stop() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed || d.state != TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+    d.state = TWAI_STATE_STOPPED;
+    return ESP_OK;
+}
+
+inline esp_err_t twai_transmit(const twai_message_t* m, TickType_t) {
+    if (!m || m->data_length_code > 8) return ESP_ERR_INVALID_ARG;
+    hosttwai::Driver& d = hosttwai::driver();
+    std::function<void(const twai_message_t&)> peer;
+    {
+        std::lock_guard<std::mutex> lock(d.m);
+        if (!d.installed || d.state != TWAI_STATE_RUNNING) return ESP_ERR_INVALID_STATE;
+        if (d.general.mode == TWAI_MODE_LISTEN_ONLY) return ESP_ERR_NOT_SUPPORTED;
+        if (d.txLog) d.tx.push_back(*m);
+        if (m->self || d.loopback) hosttwai::enqueueRx(d, *m);
+        hosttwai::raise(d, TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_IDLE);
+        peer = d.onTransmit;
+    }
+    if (peer) peer(*m);
+    return ESP_OK;
+}
+
+inline esp_err_t twai_receive(twai_message_t* m, TickType_t ticks) {
+    if (!m) return ESP_ERR_INVALID_ARG;
+    hosttwai::Driver& d = hosttwai::driver();
+    std::unique_lock<std::mutex> lock(d.m);
+    if (!d.installed) return ESP_ERR_INVALID_STATE;
+    if (!hostrtos::waitFor(lock, d.cv, ticks, [&d]() { return !d.rx.empty(); })) return ESP_ERR_TIMEOUT;
+    *m = d.rx.front();
+    d.rx.pop_front();
+    return ESP_OK;
+}
+
+inline esp_err_t twai_read_alerts(uint32_t* alerts, TickType_t ticks) {
+    if (!alerts) return ESP_ERR_INVALID_ARG;
+    hosttwai::Driver& d = hosttwai::driver();
+    std::unique_lock<std::mutex> lock(d.m);
+    if (!d.installed) return ESP_ERR_INVALID_STATE;
+    bool any = hostrtos::waitFor(lock, d.cv, ticks, [&d]() { return d.alerts != 0; });
+    *alerts = d.alerts;
+    d.alerts = 0;
+    return any ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+inline esp_err_t twai_reconfigure_alerts(uint32_t enabled, uint32_t* previous) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed) return ESP_ERR_INVALID_STATE;
+    if (previous) *previous = d.general.alerts_enabled;
+    d.general.alerts_enabled = enabled;
+    d.alerts &= enabled;
+    return ESP_OK;
+}
+
+// Recovery ist sofort abgeschlossen (128 x 11 rezessive Bits entfallen)
+inline esp_err_t twai_initiate_recovery() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed || d.state != TWAI_STATE_BUS_OFF) return ESP_ERR_INVALID_STATE;
+    d.state = TWAI_STATE_STOPPED;
+    hosttwai::raise(d, TWAI_ALERT_BUS_RECOVERED);
+    return ESP_OK;
+}
+
+inline esp_err_t twai_get_status_info(twai_status_info_t* info) {
+    if (!info) return ESP_ERR_INVALID_ARG;
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed) return ESP_ERR_INVALID_STATE;
+    *info = twai_status_info_t{};
+    info->state = d.state;
+    info->msgs_to_rx = static_cast<uint32_t>(d.rx.size());
+    info->rx_missed_count = d.rxMissed;
+    return ESP_OK;
+}
+
+inline esp_err_t twai_clear_receive_queue() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    if (!d.installed) return ESP_ERR_INVALID_STATE;
+    d.rx.clear();
+    return ESP_OK;
+}
+
+#endif // HOST_DRIVER_TWAI_H
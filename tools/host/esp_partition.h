@@ -0,0 +1,47 @@
+// Host-Shim: Partitionen im RAM (Inhalt je esp_partition_t, gelöscht = 0xFF)
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+struct esp_partition_t {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+};
+
+namespace hostpart {
+inline std::vector<uint8_t>& content(const esp_partition_t* p) {
+    static std::map<const esp_partition_t*, std::vector<uint8_t>> parts;
+    std::vector<uint8_t>& c = parts[p];
+    if (c.size() != p->size) c.assign(p->size, 0xFF);
+    return c;
+}
+} // namespace hostpart
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* p, size_t offset, size_t size) {
+    if (offset + size > p->size) return ESP_ERR_INVALID_SIZE;
+    memset(hostpart::content(p).data() + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* p, size_t offset, const void* src, size_t size) {
+    if (offset + size > p->size) return ESP_ERR_INVALID_SIZE;
+    uint8_t* dst = hostpart::content(p).data() + offset;
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; ++i) dst[i] &= s[i];     // NOR-Flash: nur 1 → 0
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* p, size_t offset, void* dst, size_t size) {
+    if (offset + size > p->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, hostpart::content(p).data() + offset, size);
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_PARTITION_H
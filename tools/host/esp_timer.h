@@ -0,0 +1,14 @@
+// Host-Shim: esp_timer_get_time() auf std::chrono::steady_clock (µs seit Programmstart)
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+inline int64_t esp_timer_get_time() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,23 @@
+// Host-Shim: FreeRTOS-Grundtypen (1 Tick = 1 ms)
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFu)
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define portYIELD_FROM_ISR(...) do {} while (0)
+#define IRAM_ATTR
+
+#endif // HOST_FREERTOS_H
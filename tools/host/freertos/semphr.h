@@ -0,0 +1,53 @@
+// Host-Shim: binäre/zählende Semaphoren und Mutexe über Condition-Variable
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+struct HostSemaphore {
+    std::mutex m;
+    std::condition_variable cv;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    HostSemaphore* s = new HostSemaphore();
+    s->count = initial;
+    s->max = max;
+    return s;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+
+// Ohne Prioritätsvererbung (Host-Threads haben keine Prioritäten)
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        if (s->count >= s->max) return pdFALSE;
+        ++s->count;
+    }
+    s->cv.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t* higherPrioWoken) {
+    if (higherPrioWoken) *higherPrioWoken = pdTRUE;
+    return xSemaphoreGive(s);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(s->m);
+    if (!hostrtos::waitFor(lock, s->cv, ticks, [s]() { return s->count > 0; })) return pdFALSE;
+    --s->count;
+    return pdTRUE;
+}
+
+#endif // HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,104 @@
+// Host-Shim: Tasks als std::thread, Task-Notifications über Condition-Variable.
+// Jeder Thread (auch main) hat ein eigenes Handle; vTaskDelete(nullptr) beendet den Task.
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct HostTask {
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notify = 0;
+};
+
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+namespace hostrtos {
+
+struct TaskExit {};
+
+inline HostTask*& current() {
+    static thread_local HostTask* task = nullptr;
+    return task;
+}
+
+inline HostTask* self() {
+    HostTask*& t = current();
+    if (!t) {                       // Threads außerhalb von xTaskCreate (main, std::thread)
+        static thread_local std::unique_ptr<HostTask> own;
+        own.reset(new HostTask());
+        t = own.get();
+    }
+    return t;
+}
+
+// Wartet höchstens ticks (portMAX_DELAY = unbegrenzt) auf pred
+template<typename Pred>
+bool waitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) { cv.wait(lock, pred); return true; }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+} // namespace hostrtos
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return hostrtos::self(); }
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* arg,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    HostTask* task = new HostTask();
+    if (handle) *handle = task;
+    std::thread([fn, arg, task]() {
+        hostrtos::current() = task;
+        try { fn(arg); } catch (const hostrtos::TaskExit&) {}
+        delete task;                // Handle ist wie bei FreeRTOS danach ungültig
+    }).detach();
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task) {
+    if (!task || task == hostrtos::current()) throw hostrtos::TaskExit();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    if (ticks) std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+    else std::this_thread::yield();
+}
+
+inline void taskYIELD() { std::this_thread::yield(); }
+
+inline TickType_t xTaskGetTickCount() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return static_cast<TickType_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->m);
+        ++task->notify;
+    }
+    task->cv.notify_all();
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPrioWoken) {
+    xTaskNotifyGive(task);
+    if (higherPrioWoken) *higherPrioWoken = pdTRUE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    HostTask* t = hostrtos::self();
+    std::unique_lock<std::mutex> lock(t->m);
+    hostrtos::waitFor(lock, t->cv, ticks, [t]() { return t->notify > 0; });
+    uint32_t value = t->notify;
+    if (value) t->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+#endif // HOST_FREERTOS_TASK_H
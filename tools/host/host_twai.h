@@ -0,0 +1,92 @@
+/**
+Host-Shim für native Tests und Host-Tools
+=========================================
+Ersetzt driver/twai.h, FreeRTOS (Tasks als std::thread, 1 Tick = 1 ms), esp_timer.h,
+esp_partition.h und für bench/ das Nötigste aus Arduino.h, damit esp32_can_library.h
+und tools/capture_replay.h ohne ESP-IDF übersetzen. Einbinden über -Itools/host (siehe
+[env:native] und [env:bench_native] in platformio.ini).
+
+Testzugriff auf den simulierten Controller:
+- hostTwaiReset()               Treiber deinstallieren, Queues und Log leeren
+- hostTwaiInject(frame)         Frame "vom Bus" in die RX-Queue legen
+- hostTwaiSent()                bisher gesendete Frames (und Log leeren)
+- hostTwaiSetLoopback(true)     jeder gesendete Frame auch in die RX-Queue
+- hostTwaiOnTransmit(fn)        gesendete Frames weiterreichen (zweiter Knoten)
+- hostTwaiSetTxLog(false)       gesendete Frames nicht protokollieren (Benchmarks)
+- hostTwaiSetState(state)       z. B. TWAI_STATE_BUS_OFF, Alert wird gesetzt
+- hostTwaiTiming()              installiertes Bit-Timing
+*/
+#ifndef HOST_TWAI_H
+#define HOST_TWAI_H
+
+#include "driver/twai.h"
+#include <cstring>
+
+inline twai_message_t hostTwaiFrame(uint32_t id, const uint8_t* data, uint8_t dlc) {
+    twai_message_t m{};
+    m.identifier = id;
+    m.data_length_code = dlc;
+    if (data) memcpy(m.data, data, dlc);
+    return m;
+}
+
+inline void hostTwaiReset() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    d.installed = false;
+    d.state = TWAI_STATE_STOPPED;
+    d.rx.clear();
+    d.tx.clear();
+    d.alerts = 0;
+    d.rxMissed = 0;
+    d.loopback = false;
+    d.txLog = true;
+    d.onTransmit = nullptr;
+}
+
+inline void hostTwaiInject(const twai_message_t& m) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    hosttwai::enqueueRx(d, m);
+}
+
+inline std::vector<twai_message_t> hostTwaiSent() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    std::vector<twai_message_t> sent;
+    sent.swap(d.tx);
+    return sent;
+}
+
+inline void hostTwaiSetLoopback(bool on) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    d.loopback = on;
+}
+
+inline void hostTwaiSetTxLog(bool on) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    d.txLog = on;
+}
+
+inline void hostTwaiOnTransmit(std::function<void(const twai_message_t&)> fn) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    d.onTransmit = fn;
+}
+
+inline void hostTwaiSetState(twai_state_t state) {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    d.state = state;
+    if (state == TWAI_STATE_BUS_OFF) hosttwai::raise(d, TWAI_ALERT_BUS_OFF);
+}
+
+inline twai_timing_config_t hostTwaiTiming() {
+    hosttwai::Driver& d = hosttwai::driver();
+    std::lock_guard<std::mutex> lock(d.m);
+    return d.timing;
+}
+
+#endif // HOST_TWAI_H